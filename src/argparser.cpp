@@ -31,6 +31,7 @@ ArgParser::ArgParser( int argc, char** argv )
       m_pkgrmArgs( "" ),
       m_installRoot( "" ),
       m_ignore( "" ),
+      m_updateFrom( "" ),
       m_argc( argc ),
       m_argv( argv ),
       m_verbose( 0 ),
@@ -46,6 +47,7 @@ ArgParser::ArgParser( int argc, char** argv )
       m_strictDiff( false ),
       m_useRegex(false),
       m_fullPath(false),
+      m_reindex(false),
       m_recursive(false),
       m_printTree(false),
       m_depSort(false)
@@ -122,7 +124,7 @@ const string& ArgParser::alternateConfigFile() const
 */
 bool ArgParser::parse()
 {
-    const int commandCount = 35;
+    const int commandCount = 36;
     string commands[commandCount] = { "list", "search", "dsearch",
                                       "info",
                                       "depends", "install", "depinst",
@@ -134,7 +136,7 @@ bool ArgParser::parse()
                                       "fsearch", "lock", "unlock",
                                       "listlocked", "cat", "ls", "edit",
                                       "remove", "deptree", "dumpconfig",
-                                      "listorphans" };
+                                      "listorphans", "owner" };
 
     Type commandID[commandCount] = { LIST, SEARCH, DSEARCH, INFO,
                                      DEPENDS, INSTALL, DEPINST,
@@ -145,7 +147,7 @@ bool ArgParser::parse()
                                      DEPENDENT, SYSUP, CURRENT,
                                      FSEARCH, LOCK, UNLOCK, LISTLOCKED,
                                      CAT, LS, EDIT, REMOVE, DEPTREE,
-                                     DUMPCONFIG, LISTORPHANS };
+                                     DUMPCONFIG, LISTORPHANS, OWNER };
     if ( m_argc < 2 ) {
         return false;
     }
@@ -200,6 +202,8 @@ bool ArgParser::parse()
                 m_useRegex = true;
             } else if ( s == "--full" ) {
                 m_fullPath = true;
+            } else if ( s == "--reindex" ) {
+                m_reindex = true;
             } else if ( s == "--recursive" ) {
                 m_recursive = true;
             } else if ( s == "--tree" ) {
@@ -254,6 +258,8 @@ bool ArgParser::parse()
                 m_installRoot = s.substr(15);
             } else if ( s.substr( 0, 9 ) == "--ignore=" ) {
                 m_ignore = s.substr(9);
+            } else if ( s.substr( 0, 14 ) == "--update-from=" ) {
+                m_updateFrom = s.substr(14);
             } else {
                 m_unknownOption = s;
                 return false;
@@ -463,8 +469,21 @@ bool ArgParser::fullPath() const
     return m_fullPath;
 }
 
+bool ArgParser::reindex() const
+{
+    return m_reindex;
+}
+
 
 const string& ArgParser::ignore() const
 {
     return m_ignore;
 }
+
+/*!
+  \return the --update-from="..." file; empty if not given
+*/
+const string& ArgParser::updateFrom() const
+{
+    return m_updateFrom;
+}
@@ -37,7 +37,7 @@ public:
                 LISTINST, PRINTF, README, DEPENDENT, SYSUP,
                 CURRENT, FSEARCH, LOCK, UNLOCK, LISTLOCKED,
                 CAT, LS, EDIT, REMOVE,
-                DEPTREE, DUMPCONFIG, LISTORPHANS };
+                DEPTREE, DUMPCONFIG, LISTORPHANS, OWNER };
 
     bool isCommandGiven() const;
     bool isForced() const;
@@ -57,6 +57,7 @@ public:
     bool strictDiff() const;
     bool useRegex() const;
     bool fullPath() const;
+    bool reindex() const;
     bool recursive() const;
     bool printTree() const;
     bool depSort() const;
@@ -69,6 +70,7 @@ public:
     const string& filter() const;
     const string& installRoot() const;
     const string& ignore() const;
+    const string& updateFrom() const;
 
 
     Type commandType() const;
@@ -109,6 +111,7 @@ private:
     bool m_strictDiff;
     bool m_useRegex;
     bool m_fullPath;
+    bool m_reindex;
 
     bool m_recursive;
     bool m_printTree;
@@ -125,6 +128,7 @@ private:
     string m_unknownOption;
     string m_installRoot;
     string m_ignore;
+    string m_updateFrom;
 
     Type m_commandType;
 
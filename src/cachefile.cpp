@@ -0,0 +1,361 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        cachefile.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "cachefile.h"
+
+const char CacheFile::VERSION_STRING[4] = { 'V', '6', '\n', '\0' };
+
+// detects caches written on a machine with different byte order
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// version string, byte order mark and section count
+static const uint32_t HEADER_SIZE = 12;
+static const uint32_t SECTION_ENTRY_SIZE = 12;
+
+
+CacheFile::CacheFile()
+    : m_data( 0 ),
+      m_size( 0 ),
+      m_strings( 0 ),
+      m_stringsSize( 0 ),
+      m_records( 0 ),
+      m_recordSize( 0 ),
+      m_packageCount( 0 )
+{
+}
+
+CacheFile::~CacheFile()
+{
+    if ( m_data ) {
+        munmap( (void*)m_data, m_size );
+    }
+}
+
+/*!
+  map \a fileName and check its header
+  \return whether the file could be opened and has the right format
+*/
+CacheFile::OpenResult CacheFile::open( const string& fileName )
+{
+    int fd = ::open( fileName.c_str(), O_RDONLY );
+    if ( fd == -1 ) {
+        return ACCESS_ERR;
+    }
+
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 ) {
+        ::close( fd );
+        return ACCESS_ERR;
+    }
+    if ( st.st_size < (off_t)HEADER_SIZE ) {
+        ::close( fd );
+        return FORMAT_ERR;
+    }
+
+    void* data = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if ( data == MAP_FAILED ) {
+        return ACCESS_ERR;
+    }
+    m_data = static_cast<const char*>( data );
+    m_size = st.st_size;
+
+    const uint32_t* header = reinterpret_cast<const uint32_t*>( m_data );
+    if ( memcmp( m_data, VERSION_STRING, sizeof( VERSION_STRING ) ) != 0 ||
+         header[1] != BYTE_ORDER_MARK ) {
+        return FORMAT_ERR;
+    }
+
+    m_strings = section( STRINGS, m_stringsSize );
+    if ( !m_strings || m_stringsSize == 0 ||
+         m_strings[m_stringsSize-1] != '\0' ) {
+        return FORMAT_ERR;
+    }
+
+    uint32_t size;
+    const uint32_t* packages =
+        reinterpret_cast<const uint32_t*>( section( PACKAGES, size ) );
+    if ( !packages || size < 2 * sizeof( uint32_t ) ) {
+        return FORMAT_ERR;
+    }
+    m_recordSize = packages[0];
+    m_packageCount = packages[1];
+    m_records = packages + 2;
+    if ( m_recordSize < FIELD_COUNT ||
+         ( size / sizeof( uint32_t ) - 2 ) / m_recordSize < m_packageCount ) {
+        return FORMAT_ERR;
+    }
+
+    return OPEN_OK;
+}
+
+/*!
+  \param id the section to look for
+  \param size is set to the size of the section
+  \return a pointer to the section, or 0 if there's no such section
+*/
+const char* CacheFile::section( uint32_t id, uint32_t& size ) const
+{
+    const uint32_t* header = reinterpret_cast<const uint32_t*>( m_data );
+    uint32_t count = header[2];
+    if ( count > ( m_size - HEADER_SIZE ) / SECTION_ENTRY_SIZE ) {
+        return 0;
+    }
+
+    const uint32_t* entry = header + 3;
+    for ( uint32_t i = 0; i < count; ++i, entry += 3 ) {
+        if ( entry[0] == id ) {
+            if ( entry[1] > m_size || entry[2] > m_size - entry[1] ||
+                 entry[1] % sizeof( uint32_t ) != 0 ) {
+                return 0;
+            }
+            size = entry[2];
+            return m_data + entry[1];
+        }
+    }
+
+    return 0;
+}
+
+/*!
+  \param id the table to look for
+  \param rowSize the number of values per row
+  \param rows is set to the number of rows
+  \return a pointer to the first row, or 0 if there's no valid table \a id
+*/
+const uint32_t* CacheFile::table( uint32_t id, uint32_t rowSize,
+                                  uint32_t& rows ) const
+{
+    uint32_t size;
+    const uint32_t* data =
+        reinterpret_cast<const uint32_t*>( section( id, size ) );
+    if ( !data || size < sizeof( uint32_t ) ) {
+        return 0;
+    }
+
+    rows = data[0];
+    if ( ( size / sizeof( uint32_t ) - 1 ) / rowSize < rows ) {
+        return 0;
+    }
+    return data + 1;
+}
+
+/*!
+  \return the string at \a offset in the string table; an empty string
+  for invalid offsets
+*/
+const char* CacheFile::stringAt( uint32_t offset ) const
+{
+    if ( offset >= m_stringsSize ) {
+        return "";
+    }
+    return m_strings + offset;
+}
+
+/*! \return the number of packages in this cache */
+size_t CacheFile::packageCount() const
+{
+    return m_packageCount;
+}
+
+/*! \return field \a field of package number \a index */
+const char* CacheFile::field( size_t index, Field field ) const
+{
+    return stringAt( m_records[index * m_recordSize + field] );
+}
+
+/*! \return the flags of package number \a index */
+uint32_t CacheFile::flags( size_t index ) const
+{
+    return m_records[index * m_recordSize + FLAGS];
+}
+
+/*!
+  binary search for package \a name
+  \param name the package to look for
+  \param index set to the index of the package if found
+  \return whether the package was found
+*/
+bool CacheFile::findPackage( const char* name, size_t& index ) const
+{
+    size_t low = 0;
+    size_t high = m_packageCount;
+    while ( low < high ) {
+        size_t mid = low + ( high - low ) / 2;
+        int cmp = strcmp( field( mid, NAME ), name );
+        if ( cmp == 0 ) {
+            index = mid;
+            return true;
+        } else if ( cmp < 0 ) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return false;
+}
+
+
+CacheWriter::CacheWriter()
+{
+    // offset 0 is always the empty string
+    addString( "" );
+}
+
+/*!
+  add \a s to the string table, unless it's there already
+  \return the offset of \a s in the string table
+*/
+uint32_t CacheWriter::addString( const std::string& s )
+{
+    map<std::string, uint32_t>::iterator it = m_stringOffsets.find( s );
+    if ( it != m_stringOffsets.end() ) {
+        return it->second;
+    }
+
+    uint32_t offset = m_strings.length();
+    m_strings.append( s.c_str(), s.length() + 1 );
+    m_stringOffsets[s] = offset;
+    return offset;
+}
+
+/*!
+  add a string without looking for an equal one added before; for large
+  numbers of strings which are known to be distinct
+  \return the offset of the string
+*/
+uint32_t CacheWriter::appendString( const char* s, size_t length )
+{
+    uint32_t offset = m_strings.length();
+    m_strings.append( s, length );
+    m_strings.append( 1, '\0' );
+    return offset;
+}
+
+/*!
+  add a package record; records have to be added sorted by name
+*/
+void CacheWriter::addPackage( const uint32_t fields[CacheFile::FIELD_COUNT] )
+{
+    m_packages.insert( m_packages.end(),
+                       fields, fields + CacheFile::FIELD_COUNT );
+}
+
+/*!
+  add an additional section \a id
+*/
+void CacheWriter::addSection( uint32_t id, const vector<uint32_t>& data )
+{
+    m_sections.push_back( make_pair( id, data ) );
+}
+
+/*!
+  add a table \a id, \a rows being the values of all rows
+*/
+void CacheWriter::addTable( uint32_t id, uint32_t rowSize,
+                            const vector<uint32_t>& rows )
+{
+    vector<uint32_t> data;
+    data.reserve( rows.size() + 1 );
+    data.push_back( rows.size() / rowSize );
+    data.insert( data.end(), rows.begin(), rows.end() );
+    addSection( id, data );
+}
+
+/*!
+  Write the cache to a temporary file and move it to \a fileName, so
+  processes still using the old file aren't disturbed
+  \return true on success
+*/
+bool CacheWriter::write( const std::string& fileName )
+{
+    vector<uint32_t> packages;
+    packages.reserve( m_packages.size() + 2 );
+    packages.push_back( CacheFile::FIELD_COUNT );
+    packages.push_back( m_packages.size() / CacheFile::FIELD_COUNT );
+    packages.insert( packages.end(), m_packages.begin(), m_packages.end() );
+
+    vector< pair<uint32_t, vector<uint32_t> > > sections = m_sections;
+    sections.insert( sections.begin(),
+                     make_pair( (uint32_t)CacheFile::PACKAGES, packages ) );
+
+    // strings are padded, so all sections are aligned
+    std::string strings = m_strings;
+    strings.append( ( 4 - strings.length() % 4 ) % 4, '\0' );
+
+    uint32_t sectionCount = sections.size() + 1;
+    vector<uint32_t> header;
+    header.push_back( BYTE_ORDER_MARK );
+    header.push_back( sectionCount );
+
+    uint32_t offset = HEADER_SIZE + sectionCount * SECTION_ENTRY_SIZE;
+    header.push_back( CacheFile::STRINGS );
+    header.push_back( offset );
+    header.push_back( strings.length() );
+    offset += strings.length();
+    for ( size_t i = 0; i < sections.size(); ++i ) {
+        uint32_t size = sections[i].second.size() * sizeof( uint32_t );
+        header.push_back( sections[i].first );
+        header.push_back( offset );
+        header.push_back( size );
+        offset += size;
+    }
+
+    std::string tmpName = fileName + ".XXXXXX";
+    vector<char> tmpBuf( tmpName.begin(), tmpName.end() );
+    tmpBuf.push_back( '\0' );
+    int fd = mkstemp( &tmpBuf[0] );
+    if ( fd == -1 ) {
+        return false;
+    }
+    fchmod( fd, 0644 );
+
+    FILE* fp = fdopen( fd, "w" );
+    if ( !fp ) {
+        ::close( fd );
+        unlink( &tmpBuf[0] );
+        return false;
+    }
+
+    fwrite( CacheFile::VERSION_STRING, sizeof( CacheFile::VERSION_STRING ),
+            1, fp );
+    fwrite( &header[0], sizeof( uint32_t ), header.size(), fp );
+    fwrite( strings.data(), 1, strings.length(), fp );
+    for ( size_t i = 0; i < sections.size(); ++i ) {
+        if ( sections[i].second.size() ) {
+            fwrite( &sections[i].second[0], sizeof( uint32_t ),
+                    sections[i].second.size(), fp );
+        }
+    }
+
+    bool ok = !ferror( fp );
+    if ( fclose( fp ) != 0 ) {
+        ok = false;
+    }
+    if ( !ok || rename( &tmpBuf[0], fileName.c_str() ) != 0 ) {
+        unlink( &tmpBuf[0] );
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,194 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        cachefile.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _CACHEFILE_H_
+#define _CACHEFILE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+/*!
+  \class CacheFile
+  \brief read only, memory mapped view of a binary cache file
+
+  Layout of a cache file (all numbers are native uint32_t):
+  - the version string "V6\n\0"
+  - a byte order mark, the number of sections
+  - a table of sections (id, offset, size)
+  - the sections
+
+  The STRINGS section contains all strings, each terminated by a
+  null byte; all other sections refer to strings by their offset in
+  this section. The PACKAGES section starts with the number of fields
+  per record and the number of records, followed by the records
+  sorted by package name.
+
+  Tables are sections starting with their number of rows, followed by
+  the rows. Each row has a fixed number of values, see Section.
+
+  Readers ignore sections they don't know, so new sections can be
+  added without breaking older versions of this class.
+*/
+class CacheFile
+{
+public:
+    /*! Fields of a package record */
+    enum Field {
+        NAME,
+        PATH,
+        VERSION,
+        RELEASE,
+        DESCRIPTION,
+        DEPENDS,
+        URL,
+        PACKAGER,
+        MAINTAINER,
+        FLAGS,
+        FIELD_COUNT
+    };
+
+    /*! bits in the FLAGS field */
+    enum Flags {
+        HAS_README = 1,
+        HAS_PRE_INSTALL = 2,
+        HAS_POST_INSTALL = 4,
+        VERSION_EVALUATED = 8   /*!< version and release were evaluated by
+                                     ShellEvaluator, or that failed */
+    };
+
+    /*! known section ids */
+    enum Section {
+        STRINGS = 1,
+        PACKAGES = 2,
+        ROOTS = 3,          /*!< table: path, filter, mtime, mtime nsec */
+        FINGERPRINTS = 4,   /*!< table: a PortFingerprint per package */
+        SHADOWED = 5,       /*!< table: name, path, version, release,
+                                 PortFingerprint; sorted like
+                                 Repository::shadowedPackages() */
+        TRIGRAMS = 6,       /*!< table: trigram, first posting, postings;
+                                 sorted by trigram, see TrigramIndex */
+        TRIGRAM_POSTINGS = 7, /*!< table: a package index per row */
+
+        // sections of the footprint index, see FootprintIndex
+        FOOTPRINT_PORTS = 8,    /*!< table: port directory, footprint
+                                     mtime, mtime nsec and size, first
+                                     entry, entry count; sorted by
+                                     directory */
+        FOOTPRINT_ENTRIES = 9,  /*!< table: entry as shown, path,
+                                     basename */
+        FOOTPRINT_BASENAMES = 10, /*!< table: entries sorted by basename,
+                                       ignoring case */
+        FOOTPRINT_PATHS = 11,   /*!< table: entries sorted by path,
+                                     ignoring case */
+
+        // sections of the file owner index, see OwnerIndex
+        OWNER_DB = 12,          /*!< table: mtime, mtime nsec, size and
+                                     inode of the package db */
+        OWNER_FILES = 13,       /*!< table: path, first owner, owner
+                                     count; sorted by path */
+        OWNER_PACKAGES = 14,    /*!< table: the name of an owner per row */
+
+        // sections of the snapshot of the package db, see PkgDB
+        PKGDB_STAMP = 15,       /*!< table: mtime, mtime nsec, size and
+                                     inode of the db and the alias file */
+        PKGDB_PACKAGES = 16,    /*!< table: name, version; sorted by name */
+        PKGDB_ALIASES = 17,     /*!< table: installed provider, aliases */
+
+        EVAL_VERSIONS = 18      /*!< table: one row, 1 if ShellEvaluator
+                                     was enabled when the cache was
+                                     written; missing means 0 */
+    };
+
+    /*! number of values in a row of the tables above */
+    enum RowSize {
+        ROOT_ROW = 4,
+        EVAL_VERSIONS_ROW = 1,
+        FINGERPRINT_ROW = 5,
+        SHADOWED_ROW = 9,
+        TRIGRAM_ROW = 3,
+        FOOTPRINT_PORT_ROW = 6,
+        FOOTPRINT_ENTRY_ROW = 3,
+        OWNER_DB_ROW = 4,
+        OWNER_FILE_ROW = 3,
+        PKGDB_STAMP_ROW = 8,
+        PKGDB_PACKAGE_ROW = 2,
+        PKGDB_ALIAS_ROW = 2
+    };
+
+    /*! Result of open() */
+    enum OpenResult {
+        ACCESS_ERR,     /*!< Error opening/mapping the file */
+        FORMAT_ERR,     /*!< bad/old format */
+        OPEN_OK         /*!< Success */
+    };
+
+    static const char VERSION_STRING[4];
+
+    CacheFile();
+    ~CacheFile();
+
+    OpenResult open( const std::string& fileName );
+
+    size_t packageCount() const;
+    const char* field( size_t index, Field field ) const;
+    uint32_t flags( size_t index ) const;
+    bool findPackage( const char* name, size_t& index ) const;
+
+    const char* section( uint32_t id, uint32_t& size ) const;
+    const uint32_t* table( uint32_t id, uint32_t rowSize,
+                           uint32_t& rows ) const;
+    const char* stringAt( uint32_t offset ) const;
+
+private:
+    const char* m_data;
+    size_t m_size;
+
+    const char* m_strings;
+    uint32_t m_stringsSize;
+
+    const uint32_t* m_records;
+    uint32_t m_recordSize;
+    uint32_t m_packageCount;
+};
+
+
+/*!
+  \class CacheWriter
+  \brief collects the sections of a cache file and writes it
+
+  \sa CacheFile
+*/
+class CacheWriter
+{
+public:
+    CacheWriter();
+
+    uint32_t addString( const std::string& s );
+    uint32_t appendString( const char* s, size_t length );
+    void addPackage( const uint32_t fields[CacheFile::FIELD_COUNT] );
+    void addSection( uint32_t id, const std::vector<uint32_t>& data );
+    void addTable( uint32_t id, uint32_t rowSize,
+                   const std::vector<uint32_t>& rows );
+
+    bool write( const std::string& fileName );
+
+private:
+    std::string m_strings;
+    std::map<std::string, uint32_t> m_stringOffsets;
+
+    std::vector<uint32_t> m_packages;
+    std::vector< std::pair<uint32_t, std::vector<uint32_t> > > m_sections;
+};
+
+#endif /* _CACHEFILE_H_ */
@@ -33,6 +33,7 @@ Configuration::Configuration( const std::string& configFile,
       m_runScripts( false ),
       m_preferHigher( false ),
       m_useRegex( false ),
+      m_evalVersions( false ),
       m_makeCommand( "" ), m_addCommand( "" ),
       m_removeCommand( "" ), m_runscriptCommand( "" )
 {
@@ -187,6 +188,11 @@ void Configuration::parseLine(const string& line, bool prepend)
         if ( s == "yes" ) {
             m_useRegex = true;
         }
+    } else if ( startsWithNoCase( s, "evalversions" ) ) {
+        s = stripWhiteSpace( s.replace( 0, 12, "" ) );
+        if ( s == "yes" ) {
+            m_evalVersions = true;
+        }
     } else if ( startsWithNoCase( s, "makecommand" ) ) {
         m_makeCommand = stripWhiteSpace( s.replace( 0, 11, "" ) );
     } else if ( startsWithNoCase( s, "addcommand" ) ) {
@@ -233,4 +239,9 @@ bool Configuration::useRegex() const
     return m_useRegex;
 }
 
+bool Configuration::evalVersions() const
+{
+    return m_evalVersions;
+}
+
 
@@ -43,6 +43,7 @@ public:
     bool runScripts() const;
     bool preferHigher() const;
     bool useRegex() const;
+    bool evalVersions() const;
 
     void addConfig(const std::string& line,
                    bool configSet,
@@ -72,6 +73,7 @@ private:
     bool m_runScripts;
     bool m_preferHigher;
     bool m_useRegex;
+    bool m_evalVersions;
 
     std::string m_makeCommand;
     std::string m_addCommand;
@@ -9,13 +9,17 @@
 //  (at your option) any later version.
 ////////////////////////////////////////////////////////////////////////
 
-#include <map>
+#include <algorithm>
 #include <cassert>
 using namespace std;
 
 #include "depresolver.h"
 
 
+DepResolver::DepResolver()
+    : m_nodeCount( 0 )
+{
+}
 
 /*!
   add a dependency
@@ -24,7 +28,9 @@ using namespace std;
 */
 void DepResolver::addDependency( int first, int second )
 {
+    assert( first >= 0 && second >= 0 );
     m_dependencies.push_back( Pair( first, second ) );
+    m_nodeCount = max( m_nodeCount, max( first, second ) + 1 );
 }
 
 
@@ -32,32 +38,43 @@ void DepResolver::addDependency( int first, int second )
   resolve the dependencies
   \param result a list which will be filled with resulting indexes in 
   the correct order
-  \return true on success, false otherwise (cyclic dependencies)
+  \return true on success, false otherwise (cyclic dependencies, see
+  cycles())
 */
 bool DepResolver::resolve( list<int>& result )
 {
     return topSort( result );
 }
 
+/*!
+  \return the cycles which made the last call to resolve() fail; each
+  is sorted, and they're sorted by their first node
+*/
+const vector< vector<int> >& DepResolver::cycles() const
+{
+    return m_cycles;
+}
+
 
 /*!
-  sort the dependencies
+  sort the dependencies: Kahn's algorithm, starting with the nodes
+  without predecessor in ascending order, and then visiting successors
+  in the order their dependencies were added
 */
 bool DepResolver::topSort( list<int>& result )
 {
-    map<int, int > numPreds;   // elt -> number of predecessors
-    map<int, list<int> > successors; // elt -> number of successors
+    // elt -> number of predecessors, -1 for indexes which are no node
+    vector<int> numPreds( m_nodeCount, -1 );
 
-    list<Pair>::iterator it = m_dependencies.begin();
+    // successors of elt are successors[offsets[elt]..offsets[elt+1]]
+    vector<int> offsets( m_nodeCount + 1, 0 );
+
+    vector<Pair>::const_iterator it = m_dependencies.begin();
     for ( ; it != m_dependencies.end(); ++it ) {
 
-        // make sure every elt is a key in numpreds
-        if ( numPreds.find( it->first ) == numPreds.end() ) {
-            numPreds[it->first] = 0;
-        }
-        if ( numPreds.find( it->second ) == numPreds.end() ) {
-            numPreds[it->second] = 0;
-        }
+        // make sure every elt is a node
+        numPreds[it->first] = max( numPreds[it->first], 0 );
+        numPreds[it->second] = max( numPreds[it->second], 0 );
 
         // if they're the same, there's no real dependence
         if ( it->first == it->second ) {
@@ -65,38 +82,125 @@ bool DepResolver::topSort( list<int>& result )
         }
 
         // since first < second, second gains a pred
-        numPreds[it->second] = numPreds[it->second] + 1;
+        ++numPreds[it->second];
 
         // ... and first gains a succ
-        successors[it->first].push_back( it->second );
+        ++offsets[it->first + 1];
+    }
+
+    for ( int i = 0; i < m_nodeCount; ++i ) {
+        offsets[i + 1] += offsets[i];
+    }
+    vector<int> successors( offsets[m_nodeCount] );
+    vector<int> next( offsets.begin(), offsets.end() - 1 );
+    for ( it = m_dependencies.begin(); it != m_dependencies.end(); ++it ) {
+        if ( it->first != it->second ) {
+            successors[next[it->first]++] = it->second;
+        }
     }
 
     // suck up everything without a predecessor
-    result.clear();
-    map<int, int>::iterator mit = numPreds.begin();
-    for ( ; mit != numPreds.end(); ++mit ) {
-        if ( mit->second == 0 ) {
-            result.push_back( mit->first );
+    vector<int> preds( numPreds );
+    vector<int> sorted;
+    int nodes = 0;
+    for ( int i = 0; i < m_nodeCount; ++i ) {
+        if ( preds[i] == 0 ) {
+            sorted.push_back( i );
+        }
+        if ( preds[i] != -1 ) {
+            ++nodes;
         }
     }
 
     // for everything in answer, knock down the pred count on
     // its successors; note that answer grows *in* the loop
-    list<int>::iterator lit = result.begin();
-    for ( ; lit != result.end(); ++lit ) {
-        assert( numPreds[*lit] == 0 );
-        numPreds.erase( *lit );
-        if ( successors.find( *lit ) != successors.end() ) {
-            list<int>::iterator succIt = successors[*lit].begin();
-            for ( ; succIt != successors[*lit].end(); ++succIt ) {
-                numPreds[*succIt] = numPreds[*succIt] - 1;
-                if ( numPreds[*succIt] == 0 ) {
-                    result.push_back( *succIt );
+    for ( size_t i = 0; i < sorted.size(); ++i ) {
+        int elt = sorted[i];
+        for ( int j = offsets[elt]; j < offsets[elt + 1]; ++j ) {
+            if ( --preds[successors[j]] == 0 ) {
+                sorted.push_back( successors[j] );
+            }
+        }
+    }
+
+    result.assign( sorted.begin(), sorted.end() );
+    m_cycles.clear();
+    if ( (int)sorted.size() == nodes ) {
+        return true;
+    }
+
+    findCycles( offsets, successors, numPreds );
+    return false;
+}
+
+/*!
+  find the strongly connected components of more than one node, using
+  Tarjan's algorithm without recursion
+  \param numPreds -1 for indexes which are no node
+*/
+void DepResolver::findCycles( const vector<int>& offsets,
+                              const vector<int>& successors,
+                              const vector<int>& numPreds )
+{
+    const int UNVISITED = -1;
+    vector<int> index( m_nodeCount, UNVISITED );
+    vector<int> lowLink( m_nodeCount, 0 );
+    vector<bool> onStack( m_nodeCount, false );
+    vector<int> stack;
+    int counter = 0;
+
+    // the dfs path: a node and the position of its next successor
+    vector< pair<int, int> > path;
+
+    for ( int root = 0; root < m_nodeCount; ++root ) {
+        if ( numPreds[root] == -1 || index[root] != UNVISITED ) {
+            continue;
+        }
+
+        path.push_back( make_pair( root, offsets[root] ) );
+        index[root] = lowLink[root] = counter++;
+        stack.push_back( root );
+        onStack[root] = true;
+
+        while ( !path.empty() ) {
+            int elt = path.back().first;
+            int& succ = path.back().second;
+            if ( succ < offsets[elt + 1] ) {
+                int s = successors[succ++];
+                if ( index[s] == UNVISITED ) {
+                    path.push_back( make_pair( s, offsets[s] ) );
+                    index[s] = lowLink[s] = counter++;
+                    stack.push_back( s );
+                    onStack[s] = true;
+                } else if ( onStack[s] ) {
+                    lowLink[elt] = min( lowLink[elt], index[s] );
+                }
+                continue;
+            }
+
+            path.pop_back();
+            if ( !path.empty() ) {
+                int parent = path.back().first;
+                lowLink[parent] = min( lowLink[parent], lowLink[elt] );
+            }
+
+            if ( lowLink[elt] == index[elt] ) {
+                vector<int> component;
+                int member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = false;
+                    component.push_back( member );
+                } while ( member != elt );
+
+                if ( component.size() > 1 ) {
+                    sort( component.begin(), component.end() );
+                    m_cycles.push_back( component );
                 }
             }
-            successors.erase( *lit );
         }
     }
 
-    return numPreds.size() == 0;
+    sort( m_cycles.begin(), m_cycles.end() );
 }
@@ -13,19 +13,26 @@
 #define _DEPRESOLVER_H_
 
 #include <list>
+#include <vector>
 using namespace std;
 
 /*!
   \class DepResolver
   \brief a dependency resolver
   
-  A dependency resolver
+  A dependency resolver. The nodes are non-negative indexes, and should
+  be dense, as they index arrays. The dependencies are stored as a
+  compressed adjacency array when resolving, and sorted in linear
+  time.
 */
 class DepResolver
 {
 public:
+    DepResolver();
+
     void addDependency( int, int );
     bool resolve( list<int>& result );
+    const vector< vector<int> >& cycles() const;
 
 private:
     /*! simple int pair, so we don't have to use std::pair */
@@ -36,8 +43,16 @@ private:
     };
 
     bool topSort( list<int>& result );
+    void findCycles( const vector<int>& offsets,
+                     const vector<int>& successors,
+                     const vector<int>& numPreds );
+
+    vector<Pair> m_dependencies;
+    int m_nodeCount;
 
-    list<Pair> m_dependencies;
+    // the strongly connected components of more than one node, found if
+    // resolve() fails
+    vector< vector<int> > m_cycles;
 };
 
 #endif /* _DEPRESOLVER_H_ */
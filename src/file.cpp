@@ -14,13 +14,13 @@
 #include <unistd.h>
 #include <cstdio>
 #include <fnmatch.h>
-#include <libgen.h>
-#include <cstring>
 
 using namespace std;
 
-#include "stringhelper.h"
+#include "file.h"
+#include "footprintreader.h"
 #include "pg_regex.h"
+#include "workerpool.h"
 
 namespace File
 {
@@ -32,62 +32,128 @@ bool fileExists( const string& fileName )
 
 }
 
+namespace
+{
+    /*! the files searched by one grepJob() call */
+    struct GrepJob
+    {
+        const vector<string>* fileNames;
+        const string* pattern;
+        bool fullPath;
+        bool useRegex;
+        size_t chunkSize;
+        vector< list<string> >* results;
+        vector<char>* found;
+    };
+
+    bool grepFile( FootprintReader& reader,
+                   const string& fileName,
+                   const string& pattern,
+                   RegEx* re,
+                   list<string>& result,
+                   bool fullPath )
+    {
+        if ( !reader.open( fileName ) ) {
+            return false;
+        }
+
+        while ( reader.next() ) {
+            const string& name =
+                fullPath ? reader.path() : reader.baseName();
+            if ( re ) {
+                if ( re->match( name ) ) {
+                    result.push_back( reader.entry() );
+                }
+            } else if ( fnmatch( pattern.c_str(), name.c_str(),
+                                 FNM_CASEFOLD ) == 0 ) {
+                result.push_back( reader.entry() );
+            }
+        }
+        return true;
+    }
+
+    /*!
+      search chunk \a index of the files of the GrepJob \a data; each
+      chunk has its own RegEx, as regexec() serializes callers sharing
+      one
+    */
+    void grepJob( size_t index, void* data )
+    {
+        GrepJob* job = static_cast<GrepJob*>( data );
+        RegEx* re = job->useRegex ? new RegEx( *job->pattern ) : 0;
+        FootprintReader reader;
+
+        size_t first = index * job->chunkSize;
+        size_t last = first + job->chunkSize;
+        if ( last > job->fileNames->size() ) {
+            last = job->fileNames->size();
+        }
+        for ( size_t i = first; i < last; ++i ) {
+            (*job->found)[i] = grepFile( reader, (*job->fileNames)[i],
+                                         *job->pattern, re,
+                                         (*job->results)[i],
+                                         job->fullPath );
+        }
+
+        delete re;
+    }
+}
+
+/*!
+  search the footprint \a fileName for files matching \a pattern
+  \param result receives the matching files, as listed in the footprint
+  \param fullPath whether to match the full path rather than the
+         basename of the files
+  \param useRegex whether \a pattern is a regular expression rather
+         than a wildcard pattern
+  \return whether the footprint could be read
+*/
 bool grep( const string& fileName,
            const string& pattern,
            list<string>& result,
            bool fullPath,
            bool useRegex)
 {
-    FILE* fp;
-    fp = fopen( fileName.c_str(), "r" );
-    if ( !fp ) {
-        return false;
-    }
-    const int length = BUFSIZ;
-    char input[length];
-    char* p;
-    char* end;
-    string line;
-    string entry;
-    
-    RegEx re(pattern);
-
-    while ( fgets( input, length, fp ) ) {
-        p = strtok( input, "\t" );
-        p = strtok( NULL, "\t" );
-        p = strtok( NULL, "\t" );
-
-        if ( p ) {
-            // prepend slash to string
-            p--;
-            p[0] = '/';
-            
-            entry = p;
-            end = strstr(p, "->");
-            if (end) {
-                *end = '\0';
-            }
-            p[strlen(p)-1] = '\0'; // strip newline
-            
-            char* name = p;
-            if (!fullPath) {
-                name = basename(p);
-            }
-                
-            if (useRegex) {
-                if (re.match(name)) {
-                    result.push_back(StringHelper::stripWhiteSpace(entry));
-                }
-            } else {
-                if ( fnmatch(pattern.c_str(), name, FNM_CASEFOLD) == 0 ) {
-                    result.push_back( StringHelper::stripWhiteSpace(entry) );
-                }
-            }
-        }
+    RegEx* re = useRegex ? new RegEx( pattern ) : 0;
+    FootprintReader reader;
+    bool found = grepFile( reader, fileName, pattern, re, result, fullPath );
+    delete re;
+    return found;
+}
+
+/*!
+  search the footprints \a fileNames in parallel, like the function
+  above does for a single one
+  \param results receives the matches of fileNames[i] in results[i]
+  \param found found[i] is set to whether fileNames[i] could be read
+*/
+void grep( const vector<string>& fileNames,
+           const string& pattern,
+           vector< list<string> >& results,
+           vector<char>& found,
+           bool fullPath,
+           bool useRegex )
+{
+    results.assign( fileNames.size(), list<string>() );
+    found.assign( fileNames.size(), 0 );
+    if ( fileNames.empty() ) {
+        return;
     }
 
-    fclose( fp );
-    return true;
+    // a few chunks per thread, so threads stuck on large footprints
+    // or a slow disk don't hold up the others
+    size_t chunks = WorkerPool::defaultThreadCount() * 8;
+    GrepJob job;
+    job.fileNames = &fileNames;
+    job.pattern = &pattern;
+    job.fullPath = fullPath;
+    job.useRegex = useRegex;
+    job.chunkSize = ( fileNames.size() + chunks - 1 ) / chunks;
+    job.results = &results;
+    job.found = &found;
+
+    chunks = ( fileNames.size() + job.chunkSize - 1 ) / job.chunkSize;
+    WorkerPool::run( chunks, grepJob, &job );
 }
 
 }
@@ -14,6 +14,7 @@
 
 #include <list>
 #include <string>
+#include <vector>
 
 namespace File
 {
@@ -24,6 +25,12 @@ bool grep( const std::string& fileName,
            std::list<string>& result,
            bool fullPath,
            bool useRegex);
+void grep( const std::vector<std::string>& fileNames,
+           const std::string& pattern,
+           std::vector< std::list<std::string> >& results,
+           std::vector<char>& found,
+           bool fullPath,
+           bool useRegex );
 
 }
 
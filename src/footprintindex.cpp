@@ -0,0 +1,452 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        footprintindex.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fnmatch.h>
+#include <strings.h>
+
+#include "cachefile.h"
+#include "footprintindex.h"
+#include "footprintreader.h"
+#include "pg_regex.h"
+#include "trigramindex.h"
+#include "workerpool.h"
+
+namespace
+{
+    /*! orders entries by one of their strings, ignoring case */
+    struct CompareNoCase
+    {
+        CompareNoCase( const vector<string>& values ) : values( values ) {}
+
+        bool operator()( uint32_t e1, uint32_t e2 ) const
+        {
+            return strcasecmp( values[e1].c_str(), values[e2].c_str() ) < 0;
+        }
+
+        const vector<string>& values;
+    };
+
+    /*!
+      stat the footprint of the port in \a dir
+      \return false if there's no footprint
+    */
+    bool statFootprint( const string& dir, uint32_t& time,
+                        uint32_t& timeNsec, uint32_t& size )
+    {
+        struct stat buf;
+        if ( stat( ( dir + "/.footprint" ).c_str(), &buf ) != 0 ) {
+            return false;
+        }
+
+        time = buf.st_mtim.tv_sec;
+        timeNsec = buf.st_mtim.tv_nsec;
+        size = buf.st_size;
+        return true;
+    }
+}
+
+FootprintIndex::FootprintIndex()
+    : m_file( 0 ),
+      m_ports( 0 ),
+      m_portCount( 0 ),
+      m_entries( 0 ),
+      m_entryCount( 0 ),
+      m_baseNames( 0 ),
+      m_paths( 0 ),
+      m_fullPath( false ),
+      m_useRegex( false ),
+      m_regex( 0 ),
+      m_filtered( false )
+{
+}
+
+FootprintIndex::~FootprintIndex()
+{
+    delete m_regex;
+    delete m_file;
+}
+
+/*!
+  \return the name of the footprint index belonging to \a cacheFile
+*/
+string FootprintIndex::fileName( const string& cacheFile )
+{
+    return cacheFile + ".footprints";
+}
+
+/*!
+  map the index \a fileName
+  \return whether the file could be opened and contains an index
+*/
+bool FootprintIndex::open( const string& fileName )
+{
+    CacheFile* file = new CacheFile;
+    if ( file->open( fileName ) != CacheFile::OPEN_OK ) {
+        delete file;
+        return false;
+    }
+
+    uint32_t baseNameCount = 0;
+    uint32_t pathCount = 0;
+    m_ports = file->table( CacheFile::FOOTPRINT_PORTS,
+                           CacheFile::FOOTPRINT_PORT_ROW, m_portCount );
+    m_entries = file->table( CacheFile::FOOTPRINT_ENTRIES,
+                             CacheFile::FOOTPRINT_ENTRY_ROW, m_entryCount );
+    m_baseNames = file->table( CacheFile::FOOTPRINT_BASENAMES, 1,
+                               baseNameCount );
+    m_paths = file->table( CacheFile::FOOTPRINT_PATHS, 1, pathCount );
+    if ( !m_ports || !m_entries || !m_baseNames || !m_paths ||
+         baseNameCount != m_entryCount || pathCount != m_entryCount ) {
+        delete file;
+        return false;
+    }
+    for ( uint32_t i = 0; i < m_entryCount; ++i ) {
+        if ( m_baseNames[i] >= m_entryCount || m_paths[i] >= m_entryCount ) {
+            delete file;
+            return false;
+        }
+    }
+
+    delete m_file;
+    m_file = file;
+    return true;
+}
+
+/*!
+  set the pattern for grep(); see File::grep() for the parameters
+*/
+void FootprintIndex::setPattern( const string& pattern,
+                                 bool fullPath, bool useRegex )
+{
+    m_pattern = pattern;
+    m_fullPath = fullPath;
+    m_useRegex = useRegex;
+    delete m_regex;
+    m_regex = 0;
+    m_candidates.clear();
+    m_filtered = false;
+
+    TrigramIndex trigrams( m_file, m_entryCount );
+    if ( useRegex ) {
+        m_regex = new RegEx( pattern );
+        m_filtered = trigrams.candidates( pattern, true, m_candidates );
+        return;
+    }
+
+    string prefix = pattern.substr( 0, pattern.find_first_of( "*?[\\" ) );
+    if ( !prefix.empty() ) {
+        findPrefix( fullPath ? m_paths : m_baseNames, fullPath ? 1 : 2,
+                    prefix, m_candidates );
+        m_filtered = true;
+    } else {
+        vector<string> literals;
+        TrigramIndex::globLiterals( pattern, literals );
+        m_filtered = trigrams.candidates( literals, m_candidates );
+    }
+}
+
+/*!
+  find the entries of the footprint of \a portDir matching the pattern
+  set by setPattern(), like File::grep() does
+  \return false if the index doesn't know the current footprint of
+          \a portDir
+*/
+bool FootprintIndex::grep( const string& portDir,
+                           list<string>& result ) const
+{
+    uint32_t index;
+    Port port;
+    if ( !findPort( portDir, index ) ||
+         !statFootprint( portDir, port.time, port.timeNsec, port.size ) ||
+         !isCurrent( index, port ) ) {
+        return false;
+    }
+
+    const uint32_t* row = m_ports + index * CacheFile::FOOTPRINT_PORT_ROW;
+    uint32_t first = row[4];
+    uint32_t count = row[5];
+    if ( first > m_entryCount || count > m_entryCount - first ) {
+        return false;
+    }
+
+    if ( m_filtered ) {
+        vector<uint32_t>::const_iterator it =
+            lower_bound( m_candidates.begin(), m_candidates.end(), first );
+        for ( ; it != m_candidates.end() && *it < first + count; ++it ) {
+            if ( matches( *it ) ) {
+                result.push_back( m_file->stringAt(
+                    m_entries[*it * CacheFile::FOOTPRINT_ENTRY_ROW] ) );
+            }
+        }
+    } else {
+        for ( uint32_t i = first; i < first + count; ++i ) {
+            if ( matches( i ) ) {
+                result.push_back( m_file->stringAt(
+                    m_entries[i * CacheFile::FOOTPRINT_ENTRY_ROW] ) );
+            }
+        }
+    }
+
+    return true;
+}
+
+/*!
+  \return whether \a entry matches the pattern set by setPattern()
+*/
+bool FootprintIndex::matches( uint32_t entry ) const
+{
+    const uint32_t* row = m_entries + entry * CacheFile::FOOTPRINT_ENTRY_ROW;
+    const char* name = m_file->stringAt( row[m_fullPath ? 1 : 2] );
+    if ( m_useRegex ) {
+        return m_regex->match( name );
+    }
+    return fnmatch( m_pattern.c_str(), name, FNM_CASEFOLD ) == 0;
+}
+
+/*!
+  binary search for the port in \a dir
+  \return whether the index lists the port
+*/
+bool FootprintIndex::findPort( const string& dir, uint32_t& index ) const
+{
+    uint32_t low = 0;
+    uint32_t high = m_portCount;
+    while ( low < high ) {
+        uint32_t mid = low + ( high - low ) / 2;
+        int cmp = strcmp( m_file->stringAt(
+                              m_ports[mid * CacheFile::FOOTPRINT_PORT_ROW] ),
+                          dir.c_str() );
+        if ( cmp == 0 ) {
+            index = mid;
+            return true;
+        } else if ( cmp < 0 ) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return false;
+}
+
+/*!
+  \return whether port \a index was indexed with the footprint
+  described by \a port
+*/
+bool FootprintIndex::isCurrent( uint32_t index, const Port& port ) const
+{
+    const uint32_t* row = m_ports + index * CacheFile::FOOTPRINT_PORT_ROW;
+    return row[1] == port.time && row[2] == port.timeNsec &&
+        row[3] == port.size;
+}
+
+/*!
+  collect the entries whose string \a field starts with \a prefix,
+  ignoring case
+  \param sorted the entries, sorted by \a field
+*/
+void FootprintIndex::findPrefix( const uint32_t* sorted, uint32_t field,
+                                 const string& prefix,
+                                 vector<uint32_t>& entries ) const
+{
+    uint32_t low = 0;
+    uint32_t high = m_entryCount;
+    while ( low < high ) {
+        uint32_t mid = low + ( high - low ) / 2;
+        const char* value = m_file->stringAt(
+            m_entries[sorted[mid] * CacheFile::FOOTPRINT_ENTRY_ROW + field] );
+        if ( strncasecmp( value, prefix.c_str(), prefix.length() ) < 0 ) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    for ( uint32_t i = low; i < m_entryCount; ++i ) {
+        const char* value = m_file->stringAt(
+            m_entries[sorted[i] * CacheFile::FOOTPRINT_ENTRY_ROW + field] );
+        if ( strncasecmp( value, prefix.c_str(), prefix.length() ) != 0 ) {
+            break;
+        }
+        entries.push_back( sorted[i] );
+    }
+    sort( entries.begin(), entries.end() );
+}
+
+/*!
+  Write the index of the footprints of the ports in \a portDirs to
+  \a fileName. Footprints which didn't change since the existing index
+  was written are taken from it, the others are read using multiple
+  threads
+  \return true on success
+*/
+bool FootprintIndex::write( const string& fileName,
+                            const vector<string>& portDirs,
+                            const set<string>* changedDirs )
+{
+    FootprintIndex old;
+    WriteJob job;
+    job.old = old.open( fileName ) ? &old : 0;
+    job.changedDirs = changedDirs;
+    job.ports.resize( portDirs.size() );
+    for ( size_t i = 0; i < portDirs.size(); ++i ) {
+        job.ports[i].dir = portDirs[i];
+        job.ports[i].valid = false;
+    }
+    WorkerPool::run( job.ports.size(), readPortJob, &job );
+
+    vector<const Port*> ports;
+    for ( size_t i = 0; i < job.ports.size(); ++i ) {
+        if ( job.ports[i].valid ) {
+            ports.push_back( &job.ports[i] );
+        }
+    }
+    sort( ports.begin(), ports.end(), comparePortDir );
+
+    CacheWriter writer;
+    vector<uint32_t> portRows;
+    vector<uint32_t> entryRows;
+    vector<string> paths;
+    vector<string> baseNames;
+    for ( size_t i = 0; i < ports.size(); ++i ) {
+        const Port& port = *ports[i];
+        if ( i > 0 && port.dir == ports[i-1]->dir ) {
+            continue;
+        }
+
+        portRows.push_back( writer.addString( port.dir ) );
+        portRows.push_back( port.time );
+        portRows.push_back( port.timeNsec );
+        portRows.push_back( port.size );
+        portRows.push_back( paths.size() );
+        portRows.push_back( port.entries.size() );
+
+        vector<Entry>::const_iterator it = port.entries.begin();
+        for ( ; it != port.entries.end(); ++it ) {
+            entryRows.push_back( writer.addString( it->line ) );
+            entryRows.push_back( writer.addString( it->path ) );
+            entryRows.push_back( writer.addString( it->baseName ) );
+            paths.push_back( it->path );
+            baseNames.push_back( it->baseName );
+        }
+    }
+
+    vector<uint32_t> byBaseName( paths.size() );
+    for ( size_t i = 0; i < byBaseName.size(); ++i ) {
+        byBaseName[i] = i;
+    }
+    vector<uint32_t> byPath = byBaseName;
+    stable_sort( byBaseName.begin(), byBaseName.end(),
+                 CompareNoCase( baseNames ) );
+    stable_sort( byPath.begin(), byPath.end(), CompareNoCase( paths ) );
+
+    writer.addTable( CacheFile::FOOTPRINT_PORTS,
+                     CacheFile::FOOTPRINT_PORT_ROW, portRows );
+    writer.addTable( CacheFile::FOOTPRINT_ENTRIES,
+                     CacheFile::FOOTPRINT_ENTRY_ROW, entryRows );
+    writer.addTable( CacheFile::FOOTPRINT_BASENAMES, 1, byBaseName );
+    writer.addTable( CacheFile::FOOTPRINT_PATHS, 1, byPath );
+    TrigramIndex::write( writer, paths );
+
+    return writer.write( fileName );
+}
+
+/*!
+  read the footprint of \a port
+  \return false if there's no footprint
+*/
+bool FootprintIndex::readFootprint( Port& port )
+{
+    FootprintReader reader;
+    if ( !reader.open( port.dir + "/.footprint" ) ) {
+        return false;
+    }
+
+    while ( reader.next() ) {
+        Entry e;
+        e.line = reader.entry();
+        e.path = reader.path();
+        e.baseName = reader.baseName();
+        port.entries.push_back( e );
+    }
+    return true;
+}
+
+/*!
+  fill in port \a index of the WriteJob \a data, from the old index if
+  it's still current there, or if it's not among the changed ports
+*/
+void FootprintIndex::readPortJob( size_t index, void* data )
+{
+    WriteJob* job = static_cast<WriteJob*>( data );
+    Port& port = job->ports[index];
+    const FootprintIndex* old = job->old;
+    uint32_t oldIndex;
+    bool indexed = old && old->findPort( port.dir, oldIndex );
+
+    if ( indexed && job->changedDirs &&
+         job->changedDirs->find( port.dir ) == job->changedDirs->end() ) {
+        const uint32_t* row =
+            old->m_ports + oldIndex * CacheFile::FOOTPRINT_PORT_ROW;
+        port.time = row[1];
+        port.timeNsec = row[2];
+        port.size = row[3];
+        if ( old->copyPort( oldIndex, port ) ) {
+            return;
+        }
+    }
+
+    if ( !statFootprint( port.dir, port.time, port.timeNsec, port.size ) ) {
+        return;
+    }
+    if ( indexed && old->isCurrent( oldIndex, port ) &&
+         old->copyPort( oldIndex, port ) ) {
+        return;
+    }
+
+    port.valid = readFootprint( port );
+}
+
+/*!
+  copy the entries of port \a index to \a port
+  \return false if the index is broken
+*/
+bool FootprintIndex::copyPort( uint32_t index, Port& port ) const
+{
+    const uint32_t* row = m_ports + index * CacheFile::FOOTPRINT_PORT_ROW;
+    if ( row[4] > m_entryCount || row[5] > m_entryCount - row[4] ) {
+        return false;
+    }
+
+    port.entries.resize( row[5] );
+    for ( uint32_t i = 0; i < row[5]; ++i ) {
+        const uint32_t* entry =
+            m_entries + ( row[4] + i ) * CacheFile::FOOTPRINT_ENTRY_ROW;
+        port.entries[i].line = m_file->stringAt( entry[0] );
+        port.entries[i].path = m_file->stringAt( entry[1] );
+        port.entries[i].baseName = m_file->stringAt( entry[2] );
+    }
+    port.valid = true;
+    return true;
+}
+
+bool FootprintIndex::comparePortDir( const Port* p1, const Port* p2 )
+{
+    return p1->dir < p2->dir;
+}
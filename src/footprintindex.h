@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        footprintindex.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _FOOTPRINTINDEX_H_
+#define _FOOTPRINTINDEX_H_
+
+#include <stdint.h>
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+
+class CacheFile;
+class RegEx;
+
+/*!
+  \class FootprintIndex
+  \brief index of the files listed in the footprints of all ports
+
+  Written by 'prt-get cache' and 'prt-get fsearch --reindex' to a file
+  next to the cache file, in the same format (see CacheFile). It lists
+  the entries of each footprint, as File::grep() splits them, together
+  with the modification time and size of the footprint, so footprints
+  changed since are read again. The entries are also sorted by basename
+  and path, for patterns starting with plain characters, and indexed by
+  trigrams of their path, for all other patterns (see TrigramIndex).
+
+  Only the ports which are current in the index can be searched; the
+  others are left to File::grep(). When the changed ports are known,
+  like for 'prt-get cache --update-from', the others are taken from the
+  old index without checking their footprints.
+*/
+class FootprintIndex
+{
+public:
+    FootprintIndex();
+    ~FootprintIndex();
+
+    bool open( const std::string& fileName );
+    void setPattern( const std::string& pattern,
+                     bool fullPath, bool useRegex );
+    bool grep( const std::string& portDir,
+               std::list<std::string>& result ) const;
+
+    static std::string fileName( const std::string& cacheFile );
+    static bool write( const std::string& fileName,
+                       const std::vector<std::string>& portDirs,
+                       const std::set<std::string>* changedDirs = 0 );
+
+private:
+    FootprintIndex( const FootprintIndex& );
+    FootprintIndex& operator=( const FootprintIndex& );
+
+    /*! a line of a footprint, see FootprintReader */
+    struct Entry
+    {
+        std::string line;
+        std::string path;
+        std::string baseName;
+    };
+
+    /*! a port and its footprint, as read by write() */
+    struct Port
+    {
+        std::string dir;
+        bool valid;     /*!< false if there's no footprint */
+        uint32_t time;
+        uint32_t timeNsec;
+        uint32_t size;
+        std::vector<Entry> entries;
+    };
+
+    /*! the ports passed to readPortJob() */
+    struct WriteJob
+    {
+        const FootprintIndex* old;
+        const std::set<std::string>* changedDirs;
+        std::vector<Port> ports;
+    };
+
+    bool findPort( const std::string& dir, uint32_t& index ) const;
+    bool isCurrent( uint32_t index, const Port& port ) const;
+    bool copyPort( uint32_t index, Port& port ) const;
+    bool matches( uint32_t entry ) const;
+    void findPrefix( const uint32_t* sorted, uint32_t field,
+                     const std::string& prefix,
+                     std::vector<uint32_t>& entries ) const;
+
+    static bool readFootprint( Port& port );
+    static void readPortJob( size_t index, void* data );
+    static bool comparePortDir( const Port* p1, const Port* p2 );
+
+    CacheFile* m_file;
+    const uint32_t* m_ports;
+    uint32_t m_portCount;
+    const uint32_t* m_entries;
+    uint32_t m_entryCount;
+    const uint32_t* m_baseNames;
+    const uint32_t* m_paths;
+
+    // the pattern set by setPattern()
+    std::string m_pattern;
+    bool m_fullPath;
+    bool m_useRegex;
+    RegEx* m_regex;
+    bool m_filtered;    /*!< whether m_candidates is used */
+    std::vector<uint32_t> m_candidates;
+};
+
+#endif /* _FOOTPRINTINDEX_H_ */
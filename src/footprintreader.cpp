@@ -0,0 +1,218 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        footprintreader.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+using namespace std;
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "footprintreader.h"
+
+namespace
+{
+    // smaller footprints, which is most of them, are cheaper to read()
+    // into a buffer than to map
+    const off_t MAP_THRESHOLD = 64 * 1024;
+}
+
+FootprintReader::FootprintReader()
+    : m_data( 0 ),
+      m_size( 0 ),
+      m_pos( 0 ),
+      m_mapped( false ),
+      m_field( 0 ),
+      m_fieldLength( 0 )
+{
+}
+
+FootprintReader::~FootprintReader()
+{
+    close();
+}
+
+/*!
+  open the footprint \a fileName; large footprints are mapped, small
+  ones read into a buffer which is reused by the next open()
+  \return whether the file could be opened
+*/
+bool FootprintReader::open( const string& fileName )
+{
+    close();
+
+    int fd = ::open( fileName.c_str(), O_RDONLY | O_CLOEXEC );
+    if ( fd == -1 ) {
+        return false;
+    }
+
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 ) {
+        ::close( fd );
+        return false;
+    }
+
+    if ( st.st_size > MAP_THRESHOLD ) {
+        void* data = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( data == MAP_FAILED ) {
+            ::close( fd );
+            return false;
+        }
+        madvise( data, st.st_size, MADV_SEQUENTIAL );
+        m_data = static_cast<const char*>( data );
+        m_size = st.st_size;
+        m_mapped = true;
+    } else if ( st.st_size > 0 ) {
+        m_buffer.resize( st.st_size );
+        size_t length = 0;
+        while ( length < m_buffer.size() ) {
+            ssize_t count = read( fd, &m_buffer[length],
+                                  m_buffer.size() - length );
+            if ( count < 0 && errno == EINTR ) {
+                continue;
+            }
+            if ( count <= 0 ) {
+                break;
+            }
+            length += count;
+        }
+        m_data = m_buffer.data();
+        m_size = length;
+    }
+
+    ::close( fd );
+    return true;
+}
+
+void FootprintReader::close()
+{
+    if ( m_mapped ) {
+        munmap( (void*)m_data, m_size );
+    }
+    m_mapped = false;
+    m_data = 0;
+    m_size = 0;
+    m_pos = 0;
+    m_field = 0;
+    m_fieldLength = 0;
+}
+
+/*!
+  move to the next line listing a file
+  \return false at the end of the footprint
+*/
+bool FootprintReader::next()
+{
+    while ( m_pos < m_size ) {
+        const char* line = m_data + m_pos;
+        const char* end = static_cast<const char*>(
+            memchr( line, '\n', m_size - m_pos ) );
+        end = end ? end + 1 : m_data + m_size;
+        m_pos = end - m_data;
+
+        // like strtok(): runs of tabs separate fields
+        const char* p = line;
+        for ( int field = 0; field < 3; ++field ) {
+            while ( p < end && *p == '\t' ) {
+                ++p;
+            }
+            if ( p == end ) {
+                break;
+            }
+
+            const char* tab = static_cast<const char*>(
+                memchr( p, '\t', end - p ) );
+            if ( field == 2 ) {
+                m_field = p;
+                m_fieldLength = ( tab ? tab : end ) - p;
+                return true;
+            }
+            if ( !tab ) {
+                break;
+            }
+            p = tab;
+        }
+    }
+
+    return false;
+}
+
+/*!
+  \return the file of the current line as shown to the user, with a
+  leading slash and the target of links
+*/
+string FootprintReader::entry() const
+{
+    size_t length = m_fieldLength;
+    while ( length > 0 && isspace( (unsigned char)m_field[length-1] ) ) {
+        --length;
+    }
+    return "/" + string( m_field, length );
+}
+
+/*!
+  \return the file of the current line as matched by File::grep(): with
+  a leading slash, without the target of links and the character before
+  it, which is usually the newline or a space
+*/
+const string& FootprintReader::path()
+{
+    size_t length = pathLength();
+    if ( length == 0 ) {
+        m_path.clear();
+    } else {
+        m_path.assign( 1, '/' );
+        m_path.append( m_field, length - 1 );
+    }
+    return m_path;
+}
+
+/*!
+  \return the last component of path(), as basename(3) returns it
+*/
+const string& FootprintReader::baseName()
+{
+    size_t length = pathLength();
+    if ( length == 0 ) {
+        m_baseName = ".";
+        return m_baseName;
+    }
+
+    // path() is a slash followed by the first length - 1 characters
+    size_t end = length - 1;
+    while ( end > 0 && m_field[end-1] == '/' ) {
+        --end;
+    }
+    if ( end == 0 ) {
+        m_baseName = "/";
+        return m_baseName;
+    }
+
+    const char* slash = static_cast<const char*>(
+        memrchr( m_field, '/', end ) );
+    size_t begin = slash ? slash - m_field + 1 : 0;
+    m_baseName.assign( m_field + begin, end - begin );
+    return m_baseName;
+}
+
+/*!
+  \return the length of the current field up to the target of a link
+*/
+size_t FootprintReader::pathLength() const
+{
+    const char* arrow = static_cast<const char*>(
+        memmem( m_field, m_fieldLength, "->", 2 ) );
+    return arrow ? arrow - m_field : m_fieldLength;
+}
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        footprintreader.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _FOOTPRINTREADER_H_
+#define _FOOTPRINTREADER_H_
+
+#include <cstddef>
+#include <string>
+
+/*!
+  \class FootprintReader
+  \brief iterate over the files listed in a footprint
+
+  The footprint is read at once and split in place; the file name of a
+  line is only copied when it's asked for. A line lists a file if
+  it has at least three tab separated fields; the third one is the file
+  name, relative to the root directory and followed by ' -> target' for
+  links.
+*/
+class FootprintReader
+{
+public:
+    FootprintReader();
+    ~FootprintReader();
+
+    bool open( const std::string& fileName );
+    void close();
+    bool next();
+
+    std::string entry() const;
+    const std::string& path();
+    const std::string& baseName();
+
+private:
+    FootprintReader( const FootprintReader& );
+    FootprintReader& operator=( const FootprintReader& );
+
+    size_t pathLength() const;
+
+    const char* m_data;
+    size_t m_size;
+    size_t m_pos;
+    bool m_mapped;
+    std::string m_buffer;
+
+    // the third field of the current line, including the newline if
+    // it's the last field
+    const char* m_field;
+    size_t m_fieldLength;
+
+    std::string m_path;
+    std::string m_baseName;
+};
+
+#endif /* _FOOTPRINTREADER_H_ */
@@ -14,6 +14,7 @@
 #include <iostream>
 #include <algorithm>
 #include <list>
+#include <set>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -29,6 +30,8 @@ using namespace std;
 #include "argparser.h"
 #include "process.h"
 #include "configuration.h"
+#include "footprintreader.h"
+#include "pg_regex.h"
 
 #ifdef USE_LOCKING
 #include "lockfile.h"
@@ -40,6 +43,7 @@ using namespace StringHelper;
 const string InstallTransaction::PKGMK_DEFAULT_COMMAND =  "/usr/bin/pkgmk";
 const string InstallTransaction::PKGADD_DEFAULT_COMMAND = "/usr/bin/pkgadd";
 const string InstallTransaction::PKGRM_DEFAULT_COMMAND =  "/usr/bin/pkgrm";
+const string InstallTransaction::PKGADD_CONF = "/etc/pkgadd.conf";
 
 /*!
  Create a nice InstallTransaction
@@ -133,6 +137,36 @@ InstallTransaction::install( const ArgParser* parser,
     list<string> ignoredPackages;
     StringHelper::split(parser->ignore(), ',', ignoredPackages);
 
+    // check all footprints before the first build; pkgadd would
+    // only notice after building. Forcing pkgadd overwrites the files
+    // anyway
+    list<string> pkgaddArgs;
+    StringHelper::split(parser->pkgaddArgs(), ' ', pkgaddArgs);
+    if (find(pkgaddArgs.begin(), pkgaddArgs.end(), "-f") == pkgaddArgs.end() &&
+        find(pkgaddArgs.begin(), pkgaddArgs.end(), "--force") ==
+        pkgaddArgs.end()) {
+        list<const Package*> packages;
+        list< pair<string, const Package*> >::iterator it = m_packages.begin();
+        for ( ; it != m_packages.end(); ++it ) {
+            if ( it->second &&
+                 find(ignoredPackages.begin(), ignoredPackages.end(),
+                      it->first) == ignoredPackages.end() &&
+                 ( update ||
+                   !m_pkgDB->isInstalled( it->second->name(), true ) ) ) {
+                packages.push_back( it->second );
+            }
+        }
+        checkFileConflicts( packages, parser->installRoot() );
+    }
+    if ( group && !m_fileConflicts.empty() ) {
+        return FILE_CONFLICT;
+    }
+    set<string> conflicting;
+    list< pair<string, string> >::const_iterator cit = m_fileConflicts.begin();
+    for ( ; cit != m_fileConflicts.end(); ++cit ) {
+        conflicting.insert( cit->first );
+    }
+
     list< pair<string, const Package*> >::iterator it = m_packages.begin();
     for ( ; it != m_packages.end(); ++it ) {
         const Package* package = it->second;
@@ -159,6 +193,10 @@ InstallTransaction::install( const ArgParser* parser,
             continue;
         }
 
+        if ( conflicting.find( package->name() ) != conflicting.end() ) {
+            continue;
+        }
+
         InstallTransaction::InstallResult result;
         InstallInfo info( package->hasReadme() );
         if ( parser->isTest() ||
@@ -188,6 +226,119 @@ InstallTransaction::install( const ArgParser* parser,
     return SUCCESS;
 }
 
+/*!
+  find files in the footprints of \a packages which are owned by other
+  installed packages, or listed by more than one of \a packages, and
+  store them in m_fileConflicts. Directories are shared and never
+  conflict; neither do files of installed packages which are updated
+  by this transaction and no longer listed in their footprint, nor
+  files which the INSTALL rules of pkgadd.conf below \a installRoot
+  keep pkgadd from installing
+*/
+void InstallTransaction::checkFileConflicts(
+    const list<const Package*>& packages, const string& installRoot )
+{
+    list< pair<string, bool> > rules;
+    readInstallRules( installRoot + PKGADD_CONF, rules );
+    vector< pair<RegEx*, bool> > installRules;
+    list< pair<string, bool> >::const_iterator rit = rules.begin();
+    for ( ; rit != rules.end(); ++rit ) {
+        installRules.push_back(
+            make_pair( new RegEx( rit->first, true ), rit->second ) );
+    }
+
+    set<string> names;
+    list<const Package*>::const_iterator it = packages.begin();
+    for ( ; it != packages.end(); ++it ) {
+        names.insert( (*it)->name() );
+    }
+
+    // files of the footprints checked so far, and their port
+    map<string, string> listed;
+    vector<string> owners;
+    FootprintReader reader;
+    for ( it = packages.begin(); it != packages.end(); ++it ) {
+        const string& name = (*it)->name();
+        if ( !reader.open( (*it)->path() + "/" + name + "/.footprint" ) ) {
+            continue;
+        }
+
+        while ( reader.next() ) {
+            const string& path = reader.path();
+            if ( path.empty() || path[path.length()-1] == '/' ) {
+                continue;
+            }
+
+            // like pkgadd, match without the leading slash; the last
+            // matching rule wins
+            bool install = true;
+            for ( size_t i = 0; i < installRules.size(); ++i ) {
+                if ( installRules[i].first->match( path.substr( 1 ) ) ) {
+                    install = installRules[i].second;
+                }
+            }
+            if ( !install ) {
+                continue;
+            }
+
+            if ( !m_pkgDB->findOwners( path, owners ) ) {
+                owners.clear();
+            }
+            for ( size_t i = 0; i < owners.size(); ++i ) {
+                if ( names.find( owners[i] ) == names.end() ) {
+                    m_fileConflicts.push_back(
+                        make_pair( name, path + " (" + owners[i] + ")" ) );
+                }
+            }
+
+            pair<map<string, string>::iterator, bool> result =
+                listed.insert( make_pair( path, name ) );
+            if ( !result.second && result.first->second != name ) {
+                m_fileConflicts.push_back(
+                    make_pair( name,
+                               path + " (" + result.first->second + ")" ) );
+            }
+        }
+    }
+
+    for ( size_t i = 0; i < installRules.size(); ++i ) {
+        delete installRules[i].first;
+    }
+}
+
+/*!
+  read the INSTALL rules of the pkgadd configuration \a fileName into
+  \a rules, as pairs of pattern and whether matching files are
+  installed. Lines look like 'INSTALL <regex> YES|NO'; UPGRADE rules
+  only decide which files are kept on updates and are skipped. A
+  missing file means no rules.
+*/
+void InstallTransaction::readInstallRules( const string& fileName,
+                                           list< pair<string, bool> >& rules )
+{
+    FILE* fp = fopen( fileName.c_str(), "r" );
+    if ( !fp ) {
+        return;
+    }
+
+    char line[1024];
+    while ( fgets( line, 1024, fp ) ) {
+        char event[1024];
+        char pattern[1024];
+        char action[1024];
+        if ( line[0] == '#' ||
+             sscanf( line, "%1023s %1023s %1023s",
+                     event, pattern, action ) != 3 ) {
+            continue;
+        }
+        if ( string( event ) == "INSTALL" ) {
+            rules.push_back( make_pair( string( pattern ),
+                                        string( action ) == "YES" ) );
+        }
+    }
+    fclose( fp );
+}
+
 /*!
   Install a single package
   \param package the package to be installed
@@ -453,6 +604,16 @@ bool InstallTransaction::calculateDependencies()
     }
     list<int> indexList;
     if ( ! m_resolver.resolve( indexList ) ) {
+        m_cyclicDependencies.clear();
+        const vector< vector<int> >& cycles = m_resolver.cycles();
+        vector< vector<int> >::const_iterator cit = cycles.begin();
+        for ( ; cit != cycles.end(); ++cit ) {
+            m_cyclicDependencies.push_back( list<string>() );
+            vector<int>::const_iterator nit = cit->begin();
+            for ( ; nit != cit->end(); ++nit ) {
+                m_cyclicDependencies.back().push_back( m_depList[*nit] );
+            }
+        }
         m_depCalced = false;
         return false;
     }
@@ -465,27 +626,90 @@ bool InstallTransaction::calculateDependencies()
     return true;
 }
 
+namespace
+{
+    /*! a package whose dependencies are being visited */
+    struct DepFrame
+    {
+        const Package* package;
+        int index;
+        vector<string> deps;
+        size_t next;
+    };
+
+    void pushFrame( vector<DepFrame>& stack, const Package* package,
+                    int index )
+    {
+        stack.push_back( DepFrame() );
+        DepFrame& frame = stack.back();
+        frame.package = package;
+        frame.index = index;
+        frame.next = 0;
+        if ( !package->dependencies().empty() ) {
+            split( package->dependencies(), ',', frame.deps );
+        }
+    }
+}
+
 /*!
-  recursive method to calculate dependencies
+  calculate dependencies: a depth first traversal, using a stack of
+  its own so long chains of dependencies can't overflow the call stack
   \param package package for which we want to calculate dependencies
   \param depends index if the package \a package depends on (-1 for none)
 */
 void InstallTransaction::checkDependecies( const Package* package,
                                            int depends )
 {
-    int index = -1;
-    bool newPackage = true;
-    for ( unsigned int i = 0; i < m_depList.size(); ++i ){
-        if ( m_depList[i] == package->name() ) {
-            index = i;
-            newPackage = false;
-            break;
-        }
+    vector<DepFrame> stack;
+    int index;
+    if ( addToResolver( package, depends, index ) ) {
+        pushFrame( stack, package, index );
     }
 
+    while ( !stack.empty() ) {
+        DepFrame& frame = stack.back();
+        if ( frame.next == frame.deps.size() ) {
+            stack.pop_back();
+            continue;
+        }
+
+        string dep = frame.deps[frame.next++];
+        if ( dep.empty() ) {
+            continue;
+        }
+        string::size_type pos = dep.find_last_of( '/' );
+        if ( pos != string::npos && (pos+1) < dep.length() ) {
+            dep = dep.substr( pos + 1 );
+        }
 
-    if ( index == -1 ) {
-        index = m_depList.size();
+        const Package* p = m_repo->getPackage( dep );
+        if ( !p ) {
+            m_missingPackages.
+                push_back( make_pair( dep, frame.package->name() ) );
+            continue;
+        }
+
+        // frame is invalidated by pushFrame()
+        if ( addToResolver( p, frame.index, index ) ) {
+            pushFrame( stack, p, index );
+        }
+    }
+}
+
+/*!
+  add \a package to the dependency resolver, as a dependency of the
+  package with index \a depends (-1 for none)
+  \param index is set to the index of \a package
+  \return true if \a package wasn't added before
+*/
+bool InstallTransaction::addToResolver( const Package* package,
+                                        int depends, int& index )
+{
+    pair<unordered_map<string, int>::iterator, bool> inserted =
+        m_depIndex.insert( make_pair( package->name(),
+                                      (int)m_depList.size() ) );
+    index = inserted.first->second;
+    if ( inserted.second ) {
         m_depList.push_back( package->name() );
     }
 
@@ -496,29 +720,7 @@ void InstallTransaction::checkDependecies( const Package* package,
         m_resolver.addDependency( index, index );
     }
 
-    if ( newPackage ) {
-        if ( !package->dependencies().empty() ) {
-            list<string> deps;
-            split( package->dependencies(), ',', deps );
-            list<string>::iterator it = deps.begin();
-            for ( ; it != deps.end(); ++it ) {
-                string dep = *it;
-                if ( !dep.empty() ) {
-                    string::size_type pos = dep.find_last_of( '/' );
-                    if ( pos != string::npos && (pos+1) < dep.length() ) {
-                        dep = dep.substr( pos + 1 );
-                    }
-                    const Package* p = m_repo->getPackage( dep );
-                    if ( p ) {
-                        checkDependecies( p, index );
-                    } else {
-                        m_missingPackages.
-                            push_back( make_pair( dep, package->name() ) );
-                    }
-                }
-            }
-        }
-    }
+    return inserted.second;
 }
 
 
@@ -549,6 +751,25 @@ const list< pair<string, string> >& InstallTransaction::missing() const
     return m_missingPackages;
 }
 
+/*!
+  \return files of packages to be installed owned by other packages, as
+  pairs of the package and the file with its owner
+*/
+const list< pair<string, string> >&
+InstallTransaction::fileConflicts() const
+{
+    return m_fileConflicts;
+}
+
+/*!
+  \return the ports depending on each other if calcDependencies()
+  returned CYCLIC_DEPEND, one list per cycle
+*/
+const list< list<string> >& InstallTransaction::cyclicDependencies() const
+{
+    return m_cyclicDependencies;
+}
+
 
 /*!
   \return packages which were requested to be installed but are already
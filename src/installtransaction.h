@@ -15,6 +15,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 using namespace std;
@@ -49,6 +50,7 @@ public:
     static const std::string PKGMK_DEFAULT_COMMAND;
     static const std::string PKGADD_DEFAULT_COMMAND;
     static const std::string PKGRM_DEFAULT_COMMAND;
+    static const std::string PKGADD_CONF;
 
 
     /*! Result of an installation */
@@ -65,7 +67,8 @@ public:
         LOG_DIR_FAILURE,     /*!< couldn't create log directory */
         LOG_FILE_FAILURE,    /*!< couldn't create log file */
         NO_LOG_FILE,         /*!< no log file specified */
-        CANT_LOCK_LOG_FILE   /*!< can't create lock for log file */
+        CANT_LOCK_LOG_FILE,  /*!< can't create lock for log file */
+        FILE_CONFLICT        /*!< files owned by other packages */
     };
 
     enum State {
@@ -97,6 +100,8 @@ public:
     const list<string>& dependencies() const;
     const list< pair<string,string> >& missing() const;
     const list< pair<string, InstallInfo> >& installError() const;
+    const list< pair<string, string> >& fileConflicts() const;
+    const list< list<string> >& cyclicDependencies() const;
 
     static string getPkgmkPackageDir();
     static string getPkgmkCompressionMode();
@@ -104,6 +109,11 @@ public:
 private:
     bool calculateDependencies();
     void checkDependecies( const Package* package, int depends=-1 );
+    bool addToResolver( const Package* package, int depends, int& index );
+    void checkFileConflicts( const list<const Package*>& packages,
+                             const string& installRoot );
+    static void readInstallRules( const string& fileName,
+                                  list< pair<string, bool> >& rules );
 
     InstallResult installPackage( const Package* package,
                                   const ArgParser* parser,
@@ -136,6 +146,7 @@ private:
 
     list<string> m_depNameList;
     vector<string> m_depList;
+    unordered_map<string, int> m_depIndex; // name -> index in m_depList
 
     // packages requested to be installed not found in the ports tree
     list< pair<string, string> > m_missingPackages;
@@ -143,6 +154,13 @@ private:
     // packages where build/installed failed
     list< pair<string, InstallInfo> > m_installErrors;
 
+    // packages< pair<name, conflicting file> > not installed because of
+    // files owned by other packages
+    list< pair<string, string> > m_fileConflicts;
+
+    // ports depending on each other, one list per cycle
+    list< list<string> > m_cyclicDependencies;
+
     /// prt-get itself
     const Configuration* m_config;
 
@@ -9,10 +9,18 @@
 //  (at your option) any later version.
 ////////////////////////////////////////////////////////////////////////
 
+#include <cerrno>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 
+#include <sys/types.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "locker.h"
 #include "repository.h"
 
@@ -20,45 +28,138 @@ const string Locker::LOCKER_FILE_PATH = "/var/lib/pkg/";
 const string Locker::LOCKER_FILE = "prt-get.locker";
 
 Locker::Locker()
-    : m_openFailed( false )
+    : m_isLoaded( false ),
+      m_openFailed( false )
 {
-    string fName = LOCKER_FILE_PATH + LOCKER_FILE;
-    FILE* fp = fopen( fName.c_str(), "r" );
-    if ( fp ) {
-        char input[512];
-        while ( fgets( input, 512, fp ) ) {
-            if ( input[strlen( input )-1] == '\n' ) {
-                input[strlen( input )-1] = '\0';
-            }
-            if ( strlen( input ) > 0 ) {
-                m_packages.push_back( input );
-            }
+}
+
+/*!
+  read the locker file, if that didn't happen yet
+*/
+void Locker::load() const
+{
+    if ( m_isLoaded ) {
+        return;
+    }
+    m_isLoaded = true;
+
+    m_openFailed = !read( LOCKER_FILE_PATH + LOCKER_FILE, m_packages );
+    m_lookup.insert( m_packages.begin(), m_packages.end() );
+}
+
+/*!
+  read the locked packages from \a fileName, one per line
+  \return false if the file can't be opened
+*/
+bool Locker::read( const string& fileName, vector<string>& packages )
+{
+    FILE* fp = fopen( fileName.c_str(), "r" );
+    if ( !fp ) {
+        return false;
+    }
+
+    char input[512];
+    while ( fgets( input, 512, fp ) ) {
+        if ( input[strlen( input )-1] == '\n' ) {
+            input[strlen( input )-1] = '\0';
+        }
+        if ( strlen( input ) > 0 ) {
+            packages.push_back( input );
         }
+    }
 
-        fclose( fp );
-    } else {
-        m_openFailed = true;
+    fclose( fp );
+    return true;
+}
+
+/*!
+  write \a packages to a temporary file which then replaces \a fileName
+*/
+bool Locker::write( const string& fileName, const vector<string>& packages )
+{
+    string tmpName = fileName + ".XXXXXX";
+    vector<char> tmpBuf( tmpName.begin(), tmpName.end() );
+    tmpBuf.push_back( '\0' );
+    int fd = mkstemp( &tmpBuf[0] );
+    if ( fd == -1 ) {
+        return false;
+    }
+    fchmod( fd, 0644 );
+
+    FILE* fp = fdopen( fd, "w" );
+    if ( !fp ) {
+        close( fd );
+        unlink( &tmpBuf[0] );
+        return false;
     }
+
+    vector<string>::const_iterator it = packages.begin();
+    for ( ; it != packages.end(); ++it ) {
+        fprintf( fp, "%s\n", it->c_str() );
+    }
+
+    bool ok = fflush( fp ) == 0 && fsync( fileno( fp ) ) == 0;
+    ok = fclose( fp ) == 0 && ok;
+    if ( !ok || rename( &tmpBuf[0], fileName.c_str() ) != 0 ) {
+        unlink( &tmpBuf[0] );
+        return false;
+    }
+
+    return true;
 }
 
+/*!
+  apply the changes made by lock() and unlock() to the locker file as
+  it is now, which another prt-get may have changed since it was read
+*/
 bool Locker::store()
 {
     if ( !Repository::createOutputDir(LOCKER_FILE_PATH) ) {
         return false;
     }
 
+    // the locker file itself is replaced, so a separate file is locked
+    string lockName = LOCKER_FILE_PATH + LOCKER_FILE + ".lock";
+    int lockFd = open( lockName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644 );
+    if ( lockFd == -1 ) {
+        return false;
+    }
+    while ( flock( lockFd, LOCK_EX ) != 0 ) {
+        if ( errno != EINTR ) {
+            close( lockFd );
+            return false;
+        }
+    }
+
     string fName = LOCKER_FILE_PATH + LOCKER_FILE;
-    FILE* fp = fopen( fName.c_str(), "w" );
-    if ( fp ) {
-        vector<string>::iterator it = m_packages.begin();
-        for ( ; it != m_packages.end(); ++it ) {
-            fprintf( fp, "%s\n", it->c_str() );
+    vector<string> packages;
+    read( fName, packages );
+    unordered_set<string> lookup( packages.begin(), packages.end() );
+
+    vector< pair<string, bool> >::const_iterator change = m_changes.begin();
+    for ( ; change != m_changes.end(); ++change ) {
+        const string& package = change->first;
+        if ( change->second ) {
+            if ( lookup.insert( package ).second ) {
+                packages.push_back( package );
+            }
+        } else if ( lookup.erase( package ) ) {
+            packages.erase( find( packages.begin(), packages.end(),
+                                  package ) );
         }
-        fclose( fp );
-        return true;
     }
 
-    return false;
+    bool ok = write( fName, packages );
+    close( lockFd );
+
+    if ( ok ) {
+        m_packages.swap( packages );
+        m_lookup.swap( lookup );
+        m_changes.clear();
+        m_isLoaded = true;
+        m_openFailed = false;
+    }
+    return ok;
 }
 
 /*!
@@ -71,6 +172,8 @@ bool Locker::lock( const string& package )
         return false;
     }
     m_packages.push_back( package );
+    m_lookup.insert( package );
+    m_changes.push_back( make_pair( package, true ) );
     return true;
 }
 
@@ -79,32 +182,31 @@ bool Locker::lock( const string& package )
 */
 bool Locker::unlock( const string& package )
 {
-    vector<string>::iterator it = find( m_packages.begin(), m_packages.end(),
-                                        package );
-    if ( it != m_packages.end() ) {
-        m_packages.erase( it );
-        return true;
+    load();
+    if ( !m_lookup.erase( package ) ) {
+        return false;
     }
 
-    return false;
+    m_packages.erase( find( m_packages.begin(), m_packages.end(),
+                            package ) );
+    m_changes.push_back( make_pair( package, false ) );
+    return true;
 }
 
 bool Locker::isLocked( const string& package ) const
 {
-    if ( find( m_packages.begin(), m_packages.end(), package ) !=
-         m_packages.end() ) {
-        return true;
-    }
-
-    return false;
+    load();
+    return m_lookup.find( package ) != m_lookup.end();
 }
 
 const vector<string>& Locker::lockedPackages() const
 {
+    load();
     return m_packages;
 }
 
 bool Locker::openFailed() const
 {
+    load();
     return m_openFailed;
 }
@@ -13,6 +13,8 @@
 #define _LOCKER_H_
 
 #include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 using namespace std;
@@ -26,6 +28,10 @@ using namespace std;
  * - not updated in prt-get sysup
  * 
  * remember to call store!
+ *
+ * The locker is read when it's first used. store() merges the changes
+ * made since into the file as it is then, under an flock(2), and
+ * replaces the file atomically, so concurrent runs don't lose updates.
  */
 class Locker
 {
@@ -42,12 +48,23 @@ public:
 
     bool openFailed() const;
 private:
+    void load() const;
+    static bool read( const string& fileName, vector<string>& packages );
+    static bool write( const string& fileName,
+                       const vector<string>& packages );
+
+    // locked packages, in the order they were locked
+    mutable vector<string> m_packages;
+    mutable unordered_set<string> m_lookup;
+    mutable bool m_isLoaded;
+
+    // lock() and unlock() calls not yet stored; true for lock()
+    vector< pair<string, bool> > m_changes;
 
-    vector<string> m_packages;
     static const string LOCKER_FILE;
     static const string LOCKER_FILE_PATH;
 
-    bool m_openFailed;
+    mutable bool m_openFailed;
 };
 
 #endif /* _LOCKER_H_ */
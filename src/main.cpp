@@ -164,6 +164,9 @@ int main( int argc, char** argv )
         case ArgParser::LISTORPHANS:
             prtGet.listOrphans();
             break;
+        case ArgParser::OWNER:
+            prtGet.owner();
+            break;
         default:
             cerr << "unknown command" << endl;
             break;
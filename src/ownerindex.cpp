@@ -0,0 +1,350 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        ownerindex.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "cachefile.h"
+#include "ownerindex.h"
+
+namespace
+{
+    /*! a file listed in the package db */
+    struct DbFile
+    {
+        const char* path;
+        uint32_t length;
+        uint32_t package;
+    };
+
+    /*! orders DbFiles by path, then by the name of their package */
+    struct CompareDbFile
+    {
+        CompareDbFile( const vector<string>& names ) : names( names ) {}
+
+        bool operator()( const DbFile& f1, const DbFile& f2 ) const
+        {
+            int result = memcmp( f1.path, f2.path,
+                                 min( f1.length, f2.length ) );
+            if ( result != 0 ) {
+                return result < 0;
+            }
+            if ( f1.length != f2.length ) {
+                return f1.length < f2.length;
+            }
+            return names[f1.package] < names[f2.package];
+        }
+
+        const vector<string>& names;
+    };
+
+    /*! \return the row stored in the OWNER_DB table for \a st */
+    vector<uint32_t> dbStatRow( const struct stat& st )
+    {
+        vector<uint32_t> row;
+        row.push_back( st.st_mtim.tv_sec );
+        row.push_back( st.st_mtim.tv_nsec );
+        row.push_back( st.st_size );
+        row.push_back( st.st_ino );
+        return row;
+    }
+
+    /*! \return the end of the line starting at \a pos */
+    const char* lineEnd( const char* pos, const char* end )
+    {
+        const char* nl =
+            static_cast<const char*>( memchr( pos, '\n', end - pos ) );
+        return nl ? nl : end;
+    }
+
+    /*! \return the start of the line following the one at \a pos */
+    const char* nextLine( const char* pos, const char* end )
+    {
+        const char* nl = lineEnd( pos, end );
+        return nl < end ? nl + 1 : end;
+    }
+}
+
+OwnerIndex::OwnerIndex()
+    : m_file( 0 ),
+      m_files( 0 ),
+      m_fileCount( 0 ),
+      m_owners( 0 ),
+      m_ownerCount( 0 )
+{
+}
+
+OwnerIndex::~OwnerIndex()
+{
+    delete m_file;
+}
+
+/*!
+  open the index of the package db \a dbFile stored in \a indexFile,
+  building it first if it's missing or outdated
+  \return false if the package db can't be read
+*/
+bool OwnerIndex::open( const string& dbFile, const string& indexFile )
+{
+    struct stat st;
+    if ( stat( dbFile.c_str(), &st ) != 0 ) {
+        return false;
+    }
+    vector<uint32_t> dbStat = dbStatRow( st );
+
+    if ( openIndex( indexFile, dbStat ) ) {
+        return true;
+    }
+    if ( write( dbFile, indexFile ) && openIndex( indexFile, dbStat ) ) {
+        return true;
+    }
+
+    // no permission to store it; the mapping stays valid after unlink()
+    string tmpFile;
+    if ( writeTemporary( dbFile, tmpFile ) ) {
+        bool ok = openIndex( tmpFile, dbStat );
+        unlink( tmpFile.c_str() );
+        return ok;
+    }
+
+    return false;
+}
+
+/*!
+  find the packages owning \a file. A leading slash is optional, and so
+  is the trailing slash of directories
+  \param owners is set to the names of the packages, sorted
+*/
+void OwnerIndex::findOwners( const string& file,
+                             vector<string>& owners ) const
+{
+    owners.clear();
+
+    string::size_type begin = file.find_first_not_of( '/' );
+    if ( begin == string::npos ) {
+        return;
+    }
+    string path = file.substr( begin );
+
+    uint32_t row;
+    if ( !findFile( path, row ) &&
+         ( path[path.length()-1] == '/' || !findFile( path + "/", row ) ) ) {
+        return;
+    }
+
+    const uint32_t* entry = m_files + row * CacheFile::OWNER_FILE_ROW;
+    uint32_t first = entry[1];
+    uint32_t count = entry[2];
+    if ( first > m_ownerCount || count > m_ownerCount - first ) {
+        return;
+    }
+    for ( uint32_t i = first; i < first + count; ++i ) {
+        owners.push_back( m_file->stringAt( m_owners[i] ) );
+    }
+}
+
+/*!
+  open \a indexFile if it's an index of the package db \a dbStat
+  describes
+*/
+bool OwnerIndex::openIndex( const string& indexFile,
+                            const vector<uint32_t>& dbStat )
+{
+    delete m_file;
+    m_file = new CacheFile;
+    m_files = 0;
+    m_owners = 0;
+
+    if ( m_file->open( indexFile ) != CacheFile::OPEN_OK ) {
+        return false;
+    }
+
+    uint32_t rows;
+    const uint32_t* db =
+        m_file->table( CacheFile::OWNER_DB, CacheFile::OWNER_DB_ROW, rows );
+    if ( !db || rows != 1 || !equal( dbStat.begin(), dbStat.end(), db ) ) {
+        return false;
+    }
+
+    const uint32_t* files = m_file->table( CacheFile::OWNER_FILES,
+                                           CacheFile::OWNER_FILE_ROW,
+                                           m_fileCount );
+    const uint32_t* owners =
+        m_file->table( CacheFile::OWNER_PACKAGES, 1, m_ownerCount );
+    if ( !files || !owners ) {
+        return false;
+    }
+
+    m_files = files;
+    m_owners = owners;
+    return true;
+}
+
+/*!
+  find \a path, relative to the root directory
+  \param row is set to the row of \a path in the OWNER_FILES table
+*/
+bool OwnerIndex::findFile( const string& path, uint32_t& row ) const
+{
+    if ( !m_files ) {
+        return false;
+    }
+
+    uint32_t low = 0;
+    uint32_t high = m_fileCount;
+    while ( low < high ) {
+        uint32_t mid = low + ( high - low ) / 2;
+        const char* s =
+            m_file->stringAt( m_files[mid * CacheFile::OWNER_FILE_ROW] );
+        int result = strcmp( s, path.c_str() );
+        if ( result == 0 ) {
+            row = mid;
+            return true;
+        }
+        if ( result < 0 ) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return false;
+}
+
+/*!
+  build the index of the package db \a dbFile and store it in
+  \a indexFile
+*/
+bool OwnerIndex::write( const string& dbFile, const string& indexFile )
+{
+    int fd = ::open( dbFile.c_str(), O_RDONLY | O_CLOEXEC );
+    if ( fd == -1 ) {
+        return false;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 ) {
+        close( fd );
+        return false;
+    }
+    const char* data = 0;
+    if ( st.st_size > 0 ) {
+        void* mapped = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( mapped == MAP_FAILED ) {
+            close( fd );
+            return false;
+        }
+        madvise( mapped, st.st_size, MADV_SEQUENTIAL );
+        data = static_cast<const char*>( mapped );
+    }
+    close( fd );
+
+    // records are the name, the version and the files of a package, one
+    // per line, followed by an empty line; see PkgDB::load()
+    vector<string> names;
+    vector<DbFile> files;
+    const char* pos = data;
+    const char* end = data + st.st_size;
+    while ( pos < end ) {
+        if ( *pos == '\n' ) {
+            ++pos;
+            continue;
+        }
+
+        names.push_back( string( pos, lineEnd( pos, end ) - pos ) );
+        pos = nextLine( pos, end );
+        if ( pos < end && *pos != '\n' ) {
+            pos = nextLine( pos, end );
+        }
+
+        while ( pos < end && *pos != '\n' ) {
+            const char* fileEnd = lineEnd( pos, end );
+            DbFile file;
+            file.path = pos;
+            file.length = fileEnd - pos;
+            file.package = names.size() - 1;
+            files.push_back( file );
+            pos = nextLine( fileEnd, end );
+        }
+    }
+
+    sort( files.begin(), files.end(), CompareDbFile( names ) );
+
+    CacheWriter writer;
+    vector<uint32_t> nameOffsets;
+    for ( size_t i = 0; i < names.size(); ++i ) {
+        nameOffsets.push_back( writer.addString( names[i] ) );
+    }
+
+    vector<uint32_t> fileRows;
+    vector<uint32_t> owners;
+    for ( size_t i = 0; i < files.size(); ++i ) {
+        const DbFile& file = files[i];
+        bool samePath = i > 0 && file.length == files[i-1].length &&
+            memcmp( file.path, files[i-1].path, file.length ) == 0;
+        if ( !samePath ) {
+            fileRows.push_back( writer.appendString( file.path,
+                                                     file.length ) );
+            fileRows.push_back( owners.size() );
+            fileRows.push_back( 0 );
+        } else if ( names[file.package] == names[files[i-1].package] ) {
+            continue;
+        }
+        owners.push_back( nameOffsets[file.package] );
+        ++fileRows.back();
+    }
+
+    if ( data ) {
+        munmap( (void*)data, st.st_size );
+    }
+
+    writer.addTable( CacheFile::OWNER_DB, CacheFile::OWNER_DB_ROW,
+                     dbStatRow( st ) );
+    writer.addTable( CacheFile::OWNER_FILES, CacheFile::OWNER_FILE_ROW,
+                     fileRows );
+    writer.addTable( CacheFile::OWNER_PACKAGES, 1, owners );
+    return writer.write( indexFile );
+}
+
+/*!
+  build the index of \a dbFile in a new temporary file
+  \param indexFile is set to the name of the file
+*/
+bool OwnerIndex::writeTemporary( const string& dbFile, string& indexFile )
+{
+    const char* dir = getenv( "TMPDIR" );
+    if ( !dir || !*dir ) {
+        dir = "/tmp";
+    }
+
+    string name = string( dir ) + "/prt-get.owners.XXXXXX";
+    vector<char> buf( name.begin(), name.end() );
+    buf.push_back( '\0' );
+    int fd = mkstemp( &buf[0] );
+    if ( fd == -1 ) {
+        return false;
+    }
+    close( fd );
+
+    indexFile = &buf[0];
+    if ( !write( dbFile, indexFile ) ) {
+        unlink( indexFile.c_str() );
+        return false;
+    }
+    return true;
+}
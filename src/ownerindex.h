@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        ownerindex.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _OWNERINDEX_H_
+#define _OWNERINDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CacheFile;
+
+/*!
+  \class OwnerIndex
+  \brief index of the installed files and the packages owning them
+
+  Built from the package db and stored next to it, in the format of the
+  cache file (see CacheFile), together with the modification time, size
+  and inode of the db; it's rebuilt whenever the db changed since. If
+  the index can't be stored there, it's built in a temporary file which
+  is removed right away.
+
+  Paths are stored like in the package db: relative to the root
+  directory, with a trailing slash for directories.
+*/
+class OwnerIndex
+{
+public:
+    OwnerIndex();
+    ~OwnerIndex();
+
+    bool open( const std::string& dbFile, const std::string& indexFile );
+    void findOwners( const std::string& file,
+                     std::vector<std::string>& owners ) const;
+
+private:
+    OwnerIndex( const OwnerIndex& );
+    OwnerIndex& operator=( const OwnerIndex& );
+
+    bool openIndex( const std::string& indexFile,
+                    const std::vector<uint32_t>& dbStat );
+    bool findFile( const std::string& path, uint32_t& row ) const;
+
+    static bool write( const std::string& dbFile,
+                       const std::string& indexFile );
+    static bool writeTemporary( const std::string& dbFile,
+                                std::string& indexFile );
+
+    CacheFile* m_file;
+    const uint32_t* m_files;
+    uint32_t m_fileCount;
+    const uint32_t* m_owners;
+    uint32_t m_ownerCount;
+};
+
+#endif /* _OWNERINDEX_H_ */
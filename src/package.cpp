@@ -13,14 +13,41 @@
 #include <iostream>
 #include <cstdio>
 #include <sys/stat.h>
-#include <sys/utsname.h>
+#include <pthread.h>
+#include <vector>
 using namespace std;
 
 #include "package.h"
+#include "cachefile.h"
+#include "packagestore.h"
+#include "pkgfileparser.h"
+#include "shellevaluator.h"
+#include "shellexpander.h"
 #include "stringhelper.h"
 using namespace StringHelper;
 
 
+// Package::load() may be called from several threads at once (see
+// Repository::loadPackages()); instead of one mutex per package, a
+// small set of mutexes is shared by all packages
+static const int LOAD_LOCK_COUNT = 64;
+static pthread_mutex_t loadLocks[LOAD_LOCK_COUNT];
+static pthread_once_t loadLocksOnce = PTHREAD_ONCE_INIT;
+
+static void initLoadLocks()
+{
+    for ( int i = 0; i < LOAD_LOCK_COUNT; ++i ) {
+        pthread_mutex_init( &loadLocks[i], 0 );
+    }
+}
+
+static pthread_mutex_t* loadLock( const Package* package )
+{
+    pthread_once( &loadLocksOnce, initLoadLocks );
+    return &loadLocks[( (size_t)package / sizeof( Package ) ) %
+                      LOAD_LOCK_COUNT];
+}
+
 
 /*!
   Create a package, which is not yet fully initialized, This is interesting
@@ -28,9 +55,10 @@ using namespace StringHelper;
 */
 Package::Package( const string& name,
                   const string& path )
-    : m_loaded( false )
+    : m_loaded( 0 )
 {
-    m_data = new PackageData( name, path );
+    m_data.name = name;
+    m_data.path = intern( path );
 }
 
 /*!
@@ -49,306 +77,440 @@ Package::Package( const string& name,
                   const string& hasReadme,
                   const string& hasPreInstall,
                   const string& hasPostInstall)
-    : m_loaded( true )
+    : m_loaded( ALL_FIELDS )
 {
-    m_data = new PackageData( name, path, version, release,
-                              description, dependencies, url,
-                              packager, maintainer, hasReadme,
-                              hasPreInstall, hasPostInstall );
-
+    m_data.name = name;
+    m_data.path = intern( path );
+    m_data.version = version;
+    m_data.release = release;
+    m_data.description = description;
+    m_data.depends = dependencies;
+    m_data.url = url;
+    m_data.packager = intern( packager );
+    m_data.maintainer = intern( maintainer );
+    m_data.hasReadme = ( stripWhiteSpace( hasReadme ) == "yes" );
+    m_data.hasPreInstall = ( stripWhiteSpace( hasPreInstall ) == "yes" );
+    m_data.hasPostInstall = ( stripWhiteSpace( hasPostInstall ) == "yes" );
 }
 
-Package::~Package()
+/*!
+  Create a package backed by record \a index of a cache file. Only the
+  name and path are copied, the other fields are read on first access
+*/
+Package::Package( const CacheFile* cache, size_t index )
+    : m_loaded( FILE_FLAGS )
 {
-    delete m_data;
+    m_data.name = cache->field( index, CacheFile::NAME );
+    m_data.path = intern( cache->field( index, CacheFile::PATH ) );
+    m_data.cache = cache;
+    m_data.cacheIndex = index;
+
+    uint32_t flags = cache->flags( index );
+    m_data.hasReadme = ( flags & CacheFile::HAS_README ) != 0;
+    m_data.hasPreInstall = ( flags & CacheFile::HAS_PRE_INSTALL ) != 0;
+    m_data.hasPostInstall = ( flags & CacheFile::HAS_POST_INSTALL ) != 0;
+    m_data.versionEvaluated = ( flags & CacheFile::VERSION_EVALUATED ) != 0;
 }
 
 /*! \return the name of this package */
 const string& Package::name() const
 {
-    return m_data->name;
+    return m_data.name;
 }
 
 /*! \return the path to this package */
 const string& Package::path() const
 {
-    return m_data->path;
+    return *m_data.path;
 }
 
 /*! \return the version of this package */
 const string& Package::version() const
 {
-    load();
-    return m_data->version;
+    load( VERSION_FIELDS );
+    if ( needsEvaluation() ) {
+        evaluateVersion();
+    }
+    return m_data.version;
 }
 
 /*! \return the release number of this package */
 const string& Package::release() const
 {
-    load();
-    return m_data->release;
+    load( VERSION_FIELDS );
+    if ( needsEvaluation() ) {
+        evaluateVersion();
+    }
+    return m_data.release;
 }
 
 /*! \return the description field of this package */
 const string& Package::description() const
 {
-    load();
-    return m_data->description;
+    load( HEADER_FIELDS );
+    return m_data.description;
 }
 
 /*! \return the dependency line of this package */
 const string& Package::dependencies() const
 {
-    load();
-    return m_data->depends;
+    load( DEPENDS_FIELD );
+    return m_data.depends;
 }
 
 /*! \return the url of this package */
 const string& Package::url() const
 {
-    load();
-    return m_data->url;
+    load( HEADER_FIELDS );
+    return m_data.url;
 }
 
 /*! \return the packager of this package */
 const string& Package::packager() const
 {
-    load();
-    return m_data->packager;
+    load( HEADER_FIELDS );
+    return *m_data.packager;
 }
 /*! \return the maintainer of this package */
 const string& Package::maintainer() const
 {
-    load();
-    return m_data->maintainer;
+    load( HEADER_FIELDS );
+    return *m_data.maintainer;
 }
 
 /*! \return whether or not this package has a readme file */
 const bool Package::hasReadme() const
 {
-    load();
-    return m_data->hasReadme;
+    load( FILE_FLAGS );
+    return m_data.hasReadme;
 }
 
 /*! \return a typically formatted version-release string */
 string Package::versionReleaseString() const
 {
-    load();
-    return m_data->versionReleaseString;
+    load( VERSION_FIELDS );
+    if ( needsEvaluation() ) {
+        evaluateVersion();
+    }
+    return m_data.version + "-" + m_data.release;
 }
 
+/*! \return whether or not this package has a pre-install script */
 const bool Package::hasPreInstall() const
 {
-    return m_data->hasPreInstall;
+    load( FILE_FLAGS );
+    return m_data.hasPreInstall;
 }
 
+/*! \return whether or not this package has a post-install script */
 const bool Package::hasPostInstall() const
 {
-    return m_data->hasPostInstall;
+    load( FILE_FLAGS );
+    return m_data.hasPostInstall;
 }
 
 /*!
-  load from Pkgfile
+  load the groups of fields in \a fields (see FieldGroup) which aren't
+  loaded yet. Safe to be called from multiple threads
 */
-void Package::load() const
+void Package::load( unsigned int fields ) const
 {
-    if ( m_loaded ) {
+    if ( ( __atomic_load_n( &m_loaded, __ATOMIC_ACQUIRE ) & fields ) ==
+         fields ) {
         return;
     }
-    m_loaded = true;
 
-    string fileName = m_data->path + "/" + m_data->name + "/Pkgfile";
+    pthread_mutex_t* lock = loadLock( this );
+    pthread_mutex_lock( lock );
+    unsigned int missing = fields & ~m_loaded;
+    if ( missing ) {
+        if ( m_data.cache ) {
+            readCacheRecord( missing );
+        } else {
+            readPkgfile( missing );
+        }
+        __atomic_store_n( &m_loaded, m_loaded | missing, __ATOMIC_RELEASE );
+    }
+    pthread_mutex_unlock( lock );
+}
 
-    // c IO is about four times faster then fstream :-(
-    FILE* fp = fopen( fileName.c_str(), "r" );
-    if ( fp == NULL ) {
+/*!
+  load the groups in \a fields from the contents of a Pkgfile read
+  elsewhere (see PkgfileReader), unless already done. The file flags are
+  only used if FILE_FLAGS is part of \a fields. Safe to be called from
+  multiple threads
+*/
+void Package::load( const string& pkgfile,
+                    unsigned int fields,
+                    bool hasReadme,
+                    bool hasPreInstall,
+                    bool hasPostInstall ) const
+{
+    if ( ( __atomic_load_n( &m_loaded, __ATOMIC_ACQUIRE ) & fields ) ==
+         fields ) {
         return;
     }
 
+    pthread_mutex_t* lock = loadLock( this );
+    pthread_mutex_lock( lock );
+    unsigned int missing = fields & ~m_loaded;
+    if ( missing & PKGFILE_FIELDS ) {
+        parsePkgfile( pkgfile, missing );
+    }
+    if ( missing & FILE_FLAGS ) {
+        m_data.hasReadme = hasReadme;
+        m_data.hasPreInstall = hasPreInstall;
+        m_data.hasPostInstall = hasPostInstall;
+    }
+    __atomic_store_n( &m_loaded, m_loaded | missing, __ATOMIC_RELEASE );
+    pthread_mutex_unlock( lock );
+}
 
-    const int length = BUFSIZ;
-    char input[length];
-    string line;
-
-    time_t timeNow;
-    time(&timeNow);
+/*!
+  \return whether loading \a fields of this package requires reading
+  its Pkgfile
+*/
+bool Package::needsPkgfile( unsigned int fields ) const
+{
+    return !m_data.cache &&
+        ( fields & PKGFILE_FIELDS &
+          ~__atomic_load_n( &m_loaded, __ATOMIC_ACQUIRE ) ) != 0;
+}
 
-    struct utsname unameBuf;
-    if (uname(&unameBuf) != 0) {
-        unameBuf.release[0] = '\0';
-    }
+/*!
+  read the groups in \a fields from the Pkgfile, and check for README and
+  install scripts if FILE_FLAGS is part of \a fields
+*/
+void Package::readPkgfile( unsigned int fields ) const
+{
+    string dir = *m_data.path + "/" + m_data.name;
 
+    if ( fields & PKGFILE_FIELDS ) {
+        string pkgfile;
+        if ( !PkgfileParser::readFile( dir + "/Pkgfile", pkgfile ) ) {
+            return;
+        }
 
+        parsePkgfile( pkgfile, fields );
+    }
 
-    while ( fgets( input, length, fp ) ) {
-
-        line = stripWhiteSpace( input );
-
-        if ( line.substr( 0, 8 ) == "version=" ) {
-            m_data->version = getValueBefore( getValue( line, '=' ), '#' );
-            m_data->version = stripWhiteSpace( m_data->version );
-
-            expandShellCommands(m_data->version, timeNow, unameBuf);
-        } else if ( line.substr( 0, 8 ) == "release=" ) {
-            m_data->release = getValueBefore( getValue( line, '=' ), '#' );
-            m_data->release = stripWhiteSpace( m_data->release );
-        } else if ( line[0] == '#' ) {
-            while ( !line.empty() &&
-                    ( line[0] == '#' || line[0] == ' ' || line[0] == '\t' ) ) {
-                line = line.substr( 1 );
-            }
-            string::size_type pos = line.find( ':' );
-            if ( pos != string::npos ) {
-                if ( startsWithNoCase( line, "desc" ) ) {
-                    m_data->description =
-                        stripWhiteSpace( getValue( line, ':' ) );
-
-                } else if ( startsWithNoCase( line, "pack" ) ) {
-                    m_data->packager =
-                        stripWhiteSpace( getValue( line, ':' ) );
-                } else if ( startsWithNoCase( line, "maint" ) ) {
-                    m_data->maintainer =
-                        stripWhiteSpace( getValue( line, ':' ) );
-                } else if ( startsWithNoCase( line, "url" ) ) {
-                    m_data->url = stripWhiteSpace( getValue( line, ':' ) );
-                } else if ( startsWithNoCase( line, "dep" ) ) {
-                    string depends = stripWhiteSpace( getValue( line, ':' ) );
-
-                    StringHelper::replaceAll( depends, " ", "," );
-                    StringHelper::replaceAll( depends, ",,", "," );
-
-                    // TODO: decide which one to use
-#if 0
-                    // remove commented out packages
-                    list<string> deps = StringHelper::split( depends, ',' );
-                    list<string>::iterator it = deps.begin();
-                    for ( ; it != deps.end(); ++it ) {
-                        if ( (*it)[0] == '#' ) {
-                            cerr << "Commented dep: " << *it << endl;
-                        } else {
-                            if ( it != deps.begin() ) {
-                                m_data->depends += ",";
-                            }
-                            m_data->depends += *it;
-                        }
-                    }
-#else
-                    m_data->depends = depends;
-#endif
-
-                }
-            }
+    if ( fields & FILE_FLAGS ) {
+        struct stat buf;
+        if ( stat( ( dir + "/README" ).c_str(), &buf ) != -1) {
+            m_data.hasReadme = true;
+        }
+        if ( stat( ( dir + "/pre-install" ).c_str(), &buf ) != -1) {
+            m_data.hasPreInstall = true;
+        }
+        if ( stat( ( dir + "/post-install" ).c_str(), &buf ) != -1) {
+            m_data.hasPostInstall = true;
         }
     }
-    fclose( fp );
+}
 
-    m_data->generateVersionReleaseString();
+/*!
+  parse the groups in \a fields from the contents of a Pkgfile
+*/
+void Package::parsePkgfile( const string& pkgfile,
+                            unsigned int fields ) const
+{
+    PkgfileFields values;
+    PkgfileParser::parse( pkgfile.data(), pkgfile.length(), values, fields );
+
+    if ( fields & VERSION_FIELDS ) {
+        ShellExpander::expand( values.version );
+        m_data.version.swap( values.version );
+        m_data.release.swap( values.release );
+        m_data.versionEvaluated = false;
+        checkShellVersion();
+    }
+    if ( fields & HEADER_FIELDS ) {
+        m_data.description.swap( values.description );
+        m_data.url.swap( values.url );
+        m_data.packager = intern( values.packager );
+        m_data.maintainer = intern( values.maintainer );
+    }
+    if ( fields & DEPENDS_FIELD ) {
+        m_data.depends.swap( values.depends );
+    }
+}
 
-    string file = m_data->path + "/" + m_data->name + "/README";
-    struct stat buf;
-    if ( stat( file.c_str(), &buf ) != -1) {
-        m_data->hasReadme = true;
+/*!
+  copy the groups in \a fields from the cache record
+*/
+void Package::readCacheRecord( unsigned int fields ) const
+{
+    const CacheFile* cache = m_data.cache;
+    size_t index = m_data.cacheIndex;
+
+    if ( fields & VERSION_FIELDS ) {
+        m_data.version = cache->field( index, CacheFile::VERSION );
+        m_data.release = cache->field( index, CacheFile::RELEASE );
+        // evaluated before the cache was written, maybe unsuccessfully
+        if ( !m_data.versionEvaluated ) {
+            checkShellVersion();
+        }
     }
-    file = m_data->path + "/" + m_data->name + "/pre-install";
-    if ( stat( file.c_str(), &buf ) != -1) {
-        m_data->hasPreInstall = true;
+    if ( fields & HEADER_FIELDS ) {
+        m_data.description = cache->field( index, CacheFile::DESCRIPTION );
+        m_data.url = cache->field( index, CacheFile::URL );
+        m_data.packager =
+            intern( cache->field( index, CacheFile::PACKAGER ) );
+        m_data.maintainer =
+            intern( cache->field( index, CacheFile::MAINTAINER ) );
     }
-    file = m_data->path + "/" + m_data->name + "/post-install";
-    if ( stat( file.c_str(), &buf ) != -1) {
-        m_data->hasPostInstall = true;
+    if ( fields & DEPENDS_FIELD ) {
+        m_data.depends = cache->field( index, CacheFile::DEPENDS );
     }
+}
 
+/*!
+  flag the version for ShellEvaluator if it still contains shell syntax
+  and evaluating Pkgfiles is enabled
+*/
+void Package::checkShellVersion() const
+{
+    bool shellVersion = ShellEvaluator::isEnabled() &&
+        ( ShellExpander::needsExpansion( m_data.version ) ||
+          ShellExpander::needsExpansion( m_data.release ) );
+    __atomic_store_n( &m_data.shellVersion, shellVersion, __ATOMIC_RELEASE );
 }
 
-void Package::setDependencies( const std::string& dependencies )
+/*!
+  \return whether the version has to be evaluated by ShellEvaluator;
+  Repository::loadPackages() does this for many packages at once
+*/
+bool Package::needsEvaluation() const
 {
-    m_data->depends = dependencies;
-}
-
-
-
-PackageData::PackageData( const string& name_,
-                          const string& path_,
-                          const string& version_,
-                          const string& release_,
-                          const string& description_,
-                          const string& dependencies_,
-                          const string& url_,
-                          const string& packager_,
-                          const string& maintainer_,
-                          const string& hasReadme_,
-                          const string& hasPreInstall_,
-                          const string& hasPostInstall_ )
-    : name( name_ ),
-      path( path_ ),
-      version( version_ ),
-      release( release_ ),
-      description( description_ ),
-      depends( dependencies_ ),
-      url( url_ ),
-      packager( packager_ ),
-      maintainer( maintainer_ )
-
-{
-    generateVersionReleaseString();
-
-    hasReadme = ( stripWhiteSpace( hasReadme_ ) == "yes" );
-    hasPreInstall = ( stripWhiteSpace( hasPreInstall_ ) == "yes" );
-    hasPostInstall = ( stripWhiteSpace( hasPostInstall_ ) == "yes" );
-}
-
-void PackageData::generateVersionReleaseString()
-{
-    versionReleaseString = version + "-" + release;
-}
-
-
-void Package::expandShellCommands(std::string& input,
-                                  const time_t& timeNow,
-                                  const struct utsname unameBuf)
-{
-    // TODO: consider dropping either of the tagsets, depending on feedback
-
-    static const int TAG_COUNT = 2;
-    string startTag[TAG_COUNT] = { "`", "$(" };
-    string endTag[TAG_COUNT] = { "`", ")" };
-
-    for (int i = 0; i < TAG_COUNT; ++i) {
-        string::size_type pos, dpos = 0;
-        
-        int len;
-        pos = 0;
-        while ((pos = input.find(startTag[i], pos)) != string::npos) {
-            len = input.length();
-            
-            if (unameBuf.release) {
-                input = replaceAll(input,
-                                   startTag[i] + "uname -r" + endTag[i],
-                                   unameBuf.release);
-            }
-
-            dpos = input.find(startTag[i] + "date");
-            if (dpos != string::npos) {
-                // NOTE: currently only works for one date pattern
-                string::size_type startpos, endpos;
-                endpos = input.find(endTag[i], dpos+1);
-                startpos = input.find('+', dpos+1);
-
-                string format = input.substr(startpos+1, endpos-startpos-1);
-
-                // support date '+...' and date "+..."
-                int len = format.length();
-                if (format[len-1] == '\'' || format[len-1] == '"') {
-                    format = format.substr(0, len-1);
-                }
-                char timeBuf[32];
-                strftime(timeBuf, 32, format.c_str(), localtime(&timeNow));
-
-                input = input.substr(0, dpos) + timeBuf +
-                    input.substr(endpos+1);
-            }
-            
-            ++pos;
+    return __atomic_load_n( &m_data.shellVersion, __ATOMIC_ACQUIRE );
+}
+
+/*!
+  \return whether the version was handled by ShellEvaluator, which
+  doesn't have to be done again as long as the Pkgfile doesn't change
+*/
+bool Package::versionEvaluated() const
+{
+    return __atomic_load_n( &m_data.versionEvaluated, __ATOMIC_ACQUIRE );
+}
+
+/*!
+  use the version and release evaluated by ShellEvaluator; if the
+  evaluation failed, the version is kept as written in the Pkgfile
+*/
+void Package::setEvaluatedVersion( const EvaluatedVersion& result ) const
+{
+    pthread_mutex_t* lock = loadLock( this );
+    pthread_mutex_lock( lock );
+    if ( m_data.shellVersion ) {
+        if ( result.valid ) {
+            m_data.version = result.version;
+            m_data.release = result.release;
         }
+        __atomic_store_n( &m_data.versionEvaluated, true, __ATOMIC_RELEASE );
+        __atomic_store_n( &m_data.shellVersion, false, __ATOMIC_RELEASE );
     }
+    pthread_mutex_unlock( lock );
+}
+
+/*!
+  evaluate the version of this package alone
+*/
+void Package::evaluateVersion() const
+{
+    vector<string> dirs( 1, *m_data.path + "/" + m_data.name );
+    vector<EvaluatedVersion> results;
+    ShellEvaluator::evaluate( dirs, results );
+    setEvaluatedVersion( results[0] );
+}
+
+/*! \return the cache file this package was read from, or 0 */
+const CacheFile* Package::cacheFile() const
+{
+    return m_data.cache;
+}
+
+/*! \return the index of this package in cacheFile() */
+size_t Package::cacheIndex() const
+{
+    return m_data.cacheIndex;
+}
+
+/*! \return the modification data used to detect changes of this port */
+const PortFingerprint& Package::fingerprint() const
+{
+    return m_data.fingerprint;
+}
+
+void Package::setFingerprint( const PortFingerprint& fingerprint )
+{
+    m_data.fingerprint = fingerprint;
+}
+
+void Package::setDependencies( const std::string& dependencies )
+{
+    load( DEPENDS_FIELD );
+    m_data.depends = dependencies;
+}
+
+
+
+/*!
+  \return the shared copy of \a s
+*/
+const string* Package::intern( const string& s )
+{
+    return StringPool::shared().intern( s );
+}
+
+
+PackageData::PackageData()
+    : path( StringPool::shared().intern( "" ) ),
+      packager( path ),
+      maintainer( path ),
+      hasReadme( false ),
+      hasPreInstall( false ),
+      hasPostInstall( false ),
+      shellVersion( false ),
+      versionEvaluated( false ),
+      cache( 0 ),
+      cacheIndex( 0 )
+{
+}
+
+PortFingerprint::PortFingerprint()
+    : dirTime( 0 ),
+      dirTimeNsec( 0 ),
+      pkgfileTime( 0 ),
+      pkgfileTimeNsec( 0 ),
+      pkgfileSize( 0 )
+{
+}
+
+/*!
+  set the fingerprint from the stat data of a port directory and its
+  Pkgfile
+*/
+void PortFingerprint::set( const struct stat& dirStat,
+                           const struct stat& pkgfileStat )
+{
+    dirTime = dirStat.st_mtim.tv_sec;
+    dirTimeNsec = dirStat.st_mtim.tv_nsec;
+    pkgfileTime = pkgfileStat.st_mtim.tv_sec;
+    pkgfileTimeNsec = pkgfileStat.st_mtim.tv_nsec;
+    pkgfileSize = pkgfileStat.st_size;
+}
+
+bool PortFingerprint::operator==( const PortFingerprint& other ) const
+{
+    return dirTime == other.dirTime &&
+        dirTimeNsec == other.dirTimeNsec &&
+        pkgfileTime == other.pkgfileTime &&
+        pkgfileTimeNsec == other.pkgfileTimeNsec &&
+        pkgfileSize == other.pkgfileSize;
+}
+
+bool PortFingerprint::operator!=( const PortFingerprint& other ) const
+{
+    return !( *this == other );
 }
@@ -12,19 +12,87 @@
 #ifndef _PACKAGE_H_
 #define _PACKAGE_H_
 
+#include <stdint.h>
 #include <string>
 
-struct PackageData;
+struct stat;
+class CacheFile;
+struct EvaluatedVersion;
+
+/*!
+  modification data of a port directory and its Pkgfile; used to find
+  ports which changed after a cache was written
+*/
+struct PortFingerprint
+{
+    PortFingerprint();
+    void set( const struct stat& dirStat, const struct stat& pkgfileStat );
+    bool operator==( const PortFingerprint& other ) const;
+    bool operator!=( const PortFingerprint& other ) const;
+
+    uint32_t dirTime;
+    uint32_t dirTimeNsec;
+    uint32_t pkgfileTime;
+    uint32_t pkgfileTimeNsec;
+    uint32_t pkgfileSize;
+};
+
+/*!
+  the fields of a package. Strings which are usually shared by many ports
+  point into StringPool::shared()
+*/
+struct PackageData
+{
+    PackageData();
+
+    std::string name;
+    const std::string* path;
+    std::string version;
+    std::string release;
+    std::string description;
+    std::string depends;
+    std::string url;
+    const std::string* packager;
+    const std::string* maintainer;
+
+    bool hasReadme;
+    bool hasPreInstall;
+    bool hasPostInstall;
+
+    // set if the version uses more than ShellExpander can handle, and
+    // still has to be evaluated by ShellEvaluator
+    bool shellVersion;
+
+    // set once ShellEvaluator handled the version, even if it failed
+    bool versionEvaluated;
+
+    PortFingerprint fingerprint;
+
+    // set for packages backed by a cache file
+    const CacheFile* cache;
+    size_t cacheIndex;
+};
 
 /*!
   \class Package
   \brief representation of a package
 
-  Representation of a package from the crux ports tree
+  Representation of a package from the crux ports tree. The fields are
+  loaded in groups, when they're first accessed.
 */
 class Package
 {
 public:
+    /*! groups of fields which can be loaded separately */
+    enum FieldGroup {
+        VERSION_FIELDS = 1,  /*!< version and release */
+        HEADER_FIELDS = 2,   /*!< description, url, packager, maintainer */
+        DEPENDS_FIELD = 4,   /*!< dependencies */
+        FILE_FLAGS = 8,      /*!< README and install scripts */
+        PKGFILE_FIELDS = VERSION_FIELDS | HEADER_FIELDS | DEPENDS_FIELD,
+        ALL_FIELDS = PKGFILE_FIELDS | FILE_FLAGS
+    };
+
     Package( const std::string& name,
              const std::string& path );
 
@@ -41,7 +109,7 @@ public:
              const std::string& hasPreInstall,
              const std::string& hasPostInstall );
 
-    ~Package();
+    Package( const CacheFile* cache, size_t index );
 
     const std::string& name() const;
     const std::string& path() const;
@@ -58,53 +126,40 @@ public:
     
     std::string versionReleaseString() const;
 
-    void setDependencies( const std::string& dependencies );
+    const CacheFile* cacheFile() const;
+    size_t cacheIndex() const;
 
+    const PortFingerprint& fingerprint() const;
+    void setFingerprint( const PortFingerprint& fingerprint );
 
-private:
-    void load() const;
+    void setDependencies( const std::string& dependencies );
 
-    static void expandShellCommands(std::string& input,
-                                    const time_t& timeNow,
-                                    const struct utsname unameBuf);
 
-    mutable PackageData* m_data;
-    mutable bool m_loaded;
+    void load( unsigned int fields = ALL_FIELDS ) const;
+    void load( const std::string& pkgfile,
+               unsigned int fields,
+               bool hasReadme,
+               bool hasPreInstall,
+               bool hasPostInstall ) const;
+    bool needsPkgfile( unsigned int fields = ALL_FIELDS ) const;
 
-  };
+    bool needsEvaluation() const;
+    bool versionEvaluated() const;
+    void setEvaluatedVersion( const EvaluatedVersion& result ) const;
 
-struct PackageData
-{
-    PackageData( const std::string& name_,
-                 const std::string& path_,
-                 const std::string& version_="",
-                 const std::string& release_="",
-                 const std::string& description_="",
-                 const std::string& dependencies_="",
-                 const std::string& url_="",
-                 const std::string& packager="",
-                 const std::string& maintainer="",
-                 const std::string& hasReadme_="",
-                 const std::string& hasPreInstall_="",
-                 const std::string& hasPostInstall_="");
+private:
+    void readPkgfile( unsigned int fields ) const;
+    void parsePkgfile( const std::string& pkgfile,
+                       unsigned int fields ) const;
+    void readCacheRecord( unsigned int fields ) const;
+    void checkShellVersion() const;
+    void evaluateVersion() const;
 
-    std::string name;
-    std::string path;
-    std::string version;
-    std::string release;
-    std::string description;
-    std::string depends;
-    std::string url;
-    std::string packager;
-    std::string maintainer;
+    static const std::string* intern( const std::string& s );
 
-    std::string versionReleaseString;
+    mutable PackageData m_data;
+    mutable unsigned int m_loaded;  /*!< the FieldGroups loaded */
 
-    bool hasReadme;
-    bool hasPreInstall;
-    bool hasPostInstall;
-    
-    void generateVersionReleaseString();
-};
+  };
 
 #endif /* _PACKAGE_H_ */
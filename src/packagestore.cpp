@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        packagestore.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <new>
+using namespace std;
+
+#include "packagestore.h"
+#include "package.h"
+
+
+StringPool::StringPool()
+{
+    pthread_mutex_init( &m_lock, 0 );
+}
+
+StringPool::~StringPool()
+{
+    pthread_mutex_destroy( &m_lock );
+}
+
+/*!
+  \return the pooled copy of \a s
+*/
+const string* StringPool::intern( const string& s )
+{
+    pthread_mutex_lock( &m_lock );
+    const string* result = &*m_strings.insert( s ).first;
+    pthread_mutex_unlock( &m_lock );
+    return result;
+}
+
+/*!
+  \return the pool used by all packages
+*/
+StringPool& StringPool::shared()
+{
+    static StringPool pool;
+    return pool;
+}
+
+
+PackageArena::PackageArena()
+    : m_used( BLOCK_SIZE )
+{
+}
+
+PackageArena::~PackageArena()
+{
+    clear();
+}
+
+/*!
+  \return uninitialized memory for one package
+*/
+void* PackageArena::allocate()
+{
+    if ( m_used == BLOCK_SIZE ) {
+        m_blocks.push_back(
+            static_cast<Package*>( operator new( BLOCK_SIZE *
+                                                 sizeof( Package ) ) ) );
+        m_used = 0;
+    }
+
+    return m_blocks.back() + m_used++;
+}
+
+/*!
+  destroy all packages and release their memory
+*/
+void PackageArena::clear()
+{
+    for ( size_t i = 0; i < m_blocks.size(); ++i ) {
+        size_t count = i + 1 < m_blocks.size() ? BLOCK_SIZE : m_used;
+        for ( size_t j = 0; j < count; ++j ) {
+            m_blocks[i][j].~Package();
+        }
+        operator delete( m_blocks[i] );
+    }
+
+    m_blocks.clear();
+    m_used = BLOCK_SIZE;
+}
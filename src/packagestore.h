@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        packagestore.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _PACKAGESTORE_H_
+#define _PACKAGESTORE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <pthread.h>
+
+class Package;
+
+/*!
+  \class StringPool
+  \brief strings shared by many packages
+
+  Values which repeat across ports, like the path of a ports directory
+  or the packager, are only stored once. Strings are never removed, so
+  the pointers returned by intern() stay valid as long as the pool
+  exists. Safe to be used from multiple threads.
+*/
+class StringPool
+{
+public:
+    StringPool();
+    ~StringPool();
+
+    const std::string* intern( const std::string& s );
+
+    static StringPool& shared();
+
+private:
+    StringPool( const StringPool& );
+    StringPool& operator=( const StringPool& );
+
+    pthread_mutex_t m_lock;
+    std::unordered_set<std::string> m_strings;
+};
+
+/*!
+  \class PackageArena
+  \brief storage for the packages of a repository
+
+  Packages are placed in large blocks instead of being allocated one by
+  one, and are all destroyed at once by clear(). Use placement new to
+  construct a package in the memory returned by allocate().
+*/
+class PackageArena
+{
+public:
+    PackageArena();
+    ~PackageArena();
+
+    void* allocate();
+    void clear();
+
+private:
+    PackageArena( const PackageArena& );
+    PackageArena& operator=( const PackageArena& );
+
+    static const size_t BLOCK_SIZE = 512;
+
+    std::vector<Package*> m_blocks;
+    size_t m_used;  /*!< packages in the last block */
+};
+
+#endif /* _PACKAGESTORE_H_ */
@@ -18,15 +18,95 @@ using namespace std;
 #include <cstring>
 #include <cstdio>
 
-#include <fnmatch.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "pkgdb.h"
+#include "cachefile.h"
 #include "datafileparser.h"
+#include "ownerindex.h"
 #include "stringhelper.h"
 #include "pg_regex.h"
 
 
+namespace
+{
+    /*!
+      \return the position after the next empty line in [pos, end), or
+      end if there's none. Going from newline to newline with memchr()
+      is a lot faster than memmem() with "\n\n"
+    */
+    const char* skipRecord( const char* pos, const char* end )
+    {
+        while ( pos < end ) {
+            const char* nl =
+                static_cast<const char*>( memchr( pos, '\n', end - pos ) );
+            if ( !nl || nl + 1 == end ) {
+                break;
+            }
+            if ( nl[1] == '\n' ) {
+                return nl + 2;
+            }
+            pos = nl + 1;
+        }
+        return end;
+    }
+
+    /*!
+      map \a fileName, with \a data set to 0 for an empty file
+      \return false if the file can't be read
+    */
+    bool mapFile( const string& fileName, const char*& data, size_t& size )
+    {
+        int fd = open( fileName.c_str(), O_RDONLY | O_CLOEXEC );
+        if ( fd == -1 ) {
+            return false;
+        }
+        struct stat st;
+        if ( fstat( fd, &st ) != 0 ) {
+            close( fd );
+            return false;
+        }
+
+        data = 0;
+        size = st.st_size;
+        if ( size > 0 ) {
+            void* mapped = mmap( 0, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if ( mapped == MAP_FAILED ) {
+                close( fd );
+                return false;
+            }
+            madvise( mapped, size, MADV_SEQUENTIAL );
+            data = static_cast<const char*>( mapped );
+        }
+        close( fd );
+        return true;
+    }
+
+    /*! append mtime, size and inode of \a fileName to \a stamp */
+    void appendStat( const string& fileName, vector<uint32_t>& stamp )
+    {
+        struct stat st;
+        if ( stat( fileName.c_str(), &st ) != 0 ) {
+            memset( &st, 0, sizeof( st ) );
+        }
+        stamp.push_back( st.st_mtim.tv_sec );
+        stamp.push_back( st.st_mtim.tv_nsec );
+        stamp.push_back( st.st_size );
+        stamp.push_back( st.st_ino );
+    }
+
+    // lookups scanning the db before it's loaded completely; each
+    // costs about as much as loading it, but usually less
+    const unsigned int MAX_SCANS = 2;
+}
+
 const string PkgDB::PKGDB = "/var/lib/pkg/db";
+const string PkgDB::OWNER_INDEX = "/var/lib/pkg/prt-get.owners";
+const string PkgDB::SNAPSHOT = "/var/lib/pkg/prt-get.snapshot";
 const string PkgDB::ALIAS_STORE = LOCALSTATEDIR"/lib/pkg/prt-get.aliases";
 
 /*!
@@ -34,10 +114,21 @@ const string PkgDB::ALIAS_STORE = LOCALSTATEDIR"/lib/pkg/prt-get.aliases";
 */
 PkgDB::PkgDB( const string& installRoot )
     : m_isLoaded( false ),
+      m_aliasesLoaded( false ),
+      m_snapshot( 0 ),
+      m_snapshotChecked( false ),
+      m_scans( 0 ),
+      m_ownerIndex( 0 ),
       m_installRoot( installRoot )
 {
 }
 
+PkgDB::~PkgDB()
+{
+    delete m_snapshot;
+    delete m_ownerIndex;
+}
+
 /*!
   Check whether a package is installed
 
@@ -52,11 +143,7 @@ bool PkgDB::isInstalled( const string& name,
                          bool* isAlias,
                          string* aliasOrignalName ) const
 {
-    if ( !load() ) {
-        return false;
-    }
-    
-    bool installed = m_packages.find( name ) != m_packages.end();
+    bool installed = findInstalled( name, 0 );
     if (!installed && useAlias) {
         string provider;
         installed = aliasExistsFor(name, provider);
@@ -80,25 +167,40 @@ bool PkgDB::isInstalled( const string& name,
 
 bool PkgDB::aliasExistsFor(const string& name, string& providerName) const
 {
-    // when used the first time, split alias names
-    if (m_splitAliases.size() < m_aliases.size()) {
-        map<string, string>::iterator it = m_aliases.begin();
-        for (; it != m_aliases.end(); ++it) {
-            StringHelper::split(it->second, ',',
-                                m_splitAliases[it->first]);
+    if ( !m_aliasesLoaded ) {
+        if ( openSnapshot() ) {
+            readSnapshot( false );
+        } else {
+            load();
         }
     }
 
-    map<string, vector<string> >::iterator it = m_splitAliases.begin();
-    for (; it != m_splitAliases.end(); ++it) {
-        if (find(it->second.begin(), it->second.end(), name) !=
-            it->second.end()) {
-            providerName = it->first;
-            return true;
-        }
+    unordered_map<string, string>::const_iterator it =
+        m_providers.find( name );
+    if ( it == m_providers.end() ) {
+        return false;
     }
 
-    return false;
+    providerName = it->second;
+    return true;
+}
+
+/*!
+  index the aliases by the names they provide. If several installed
+  packages provide a name, the one sorting first is used
+*/
+void PkgDB::indexAliases() const
+{
+    m_providers.clear();
+    map<string, string>::const_iterator it = m_aliases.begin();
+    for ( ; it != m_aliases.end(); ++it ) {
+        vector<string> names;
+        StringHelper::split( it->second, ',', names );
+        vector<string>::const_iterator name = names.begin();
+        for ( ; name != names.end(); ++name ) {
+            m_providers.insert( make_pair( *name, it->first ) );
+        }
+    }
 }
 
 /*!
@@ -132,53 +234,283 @@ bool PkgDB::load() const
     db.close();
 #endif
 
+    if ( openSnapshot() ) {
+        readSnapshot( true );
+        return true;
+    }
+
+    // taken before reading, so the snapshot is outdated rather than
+    // wrong if something changes meanwhile
+    vector<uint32_t> stamp;
+    snapshotStamp( stamp );
+
     std::map<std::string, std::string> aliases;
     DataFileParser::parse(ALIAS_STORE, aliases);
 
-    const int length = 256;
-    char line[length];
-    bool emptyLine = true;
-    bool nameRead = false;
-    string name;
-
-    string pkgdb = "";
-    if (m_installRoot != "") {
-        pkgdb = m_installRoot;
-    }
-    pkgdb += PKGDB;
-
-    FILE* fp = fopen( pkgdb.c_str(), "r" );
-    if ( fp ) {
-        while ( fgets( line, length, fp ) ) {
-            if ( emptyLine ) {
-                line[strlen(line)-1] = '\0';
-                name = line;
-                emptyLine = false;
-                nameRead = true;
-            } else if ( nameRead ) {
-                line[strlen(line)-1] = '\0';
-                m_packages[ name ] = line;
-                nameRead = false;
-                if (aliases.find(name) != aliases.end()) {
-                    m_aliases[name] = aliases[name];
+    const char* data;
+    size_t size;
+    if ( !mapFile( m_installRoot + PKGDB, data, size ) ) {
+        return false;
+    }
+
+    // a record is the name, the version and the files of a package, one
+    // per line, and ends with an empty line. Only the first two lines
+    // are used, the file lists are skipped
+    const char* pos = data;
+    const char* end = data + size;
+    while ( pos < end ) {
+        if ( *pos == '\n' ) {
+            ++pos;
+            continue;
+        }
+
+        const char* nameEnd =
+            static_cast<const char*>( memchr( pos, '\n', end - pos ) );
+        if ( !nameEnd ) {
+            break;
+        }
+        const char* version = nameEnd + 1;
+        const char* versionEnd = static_cast<const char*>(
+            memchr( version, '\n', end - version ) );
+        if ( !versionEnd ) {
+            versionEnd = end;
+        }
+
+        string name( pos, nameEnd - pos );
+        m_packages[ name ].assign( version, versionEnd - version );
+        map<string, string>::iterator alias = aliases.find( name );
+        if ( alias != aliases.end() ) {
+            m_aliases[name] = alias->second;
+        }
+
+        // starting at the newline ending the name if there's no version
+        pos = skipRecord( versionEnd - 1, end );
+    }
+
+    if ( data ) {
+        munmap( (void*)data, size );
+    }
+
+    m_isLoaded = true;
+    m_aliasesLoaded = true;
+    indexAliases();
+    writeSnapshot( stamp );
+    return true;
+}
+
+/*!
+  look up the installed package \a name, without loading the whole db
+  if possible
+  \param version if not 0, set to the version of the package
+*/
+bool PkgDB::findInstalled( const string& name, string* version ) const
+{
+    if ( !m_isLoaded ) {
+        if ( openSnapshot() ) {
+            uint32_t rows;
+            const uint32_t* packages =
+                m_snapshot->table( CacheFile::PKGDB_PACKAGES,
+                                   CacheFile::PKGDB_PACKAGE_ROW, rows );
+            uint32_t low = 0;
+            uint32_t high = rows;
+            while ( low < high ) {
+                uint32_t mid = low + ( high - low ) / 2;
+                const uint32_t* row =
+                    packages + mid * CacheFile::PKGDB_PACKAGE_ROW;
+                int result = strcmp( m_snapshot->stringAt( row[0] ),
+                                     name.c_str() );
+                if ( result == 0 ) {
+                    if ( version ) {
+                        *version = m_snapshot->stringAt( row[1] );
+                    }
+                    return true;
+                }
+                if ( result < 0 ) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
                 }
             }
-            if ( line[0] == '\n' ) {
-                emptyLine = true;
-            }
+            return false;
+        }
 
+        if ( m_scans < MAX_SCANS ) {
+            ++m_scans;
+            return scanDb( name, version );
         }
-    } else {
+    }
+
+    if ( !load() ) {
         return false;
     }
+    map<string, string>::const_iterator it = m_packages.find( name );
+    if ( it == m_packages.end() ) {
+        return false;
+    }
+    if ( version ) {
+        *version = it->second;
+    }
+    return true;
+}
 
-    m_isLoaded = true;
+/*!
+  search the db for the record of \a name, which starts with its name
+  on a line of its own, after an empty line or at the start of the db
+  \param version if not 0, set to the version of the package
+*/
+bool PkgDB::scanDb( const string& name, string* version ) const
+{
+    const char* data;
+    size_t size;
+    if ( name.empty() || !mapFile( m_installRoot + PKGDB, data, size ) ) {
+        return false;
+    }
+
+    const char* record = 0;
+    if ( size > name.length() &&
+         memcmp( data, name.data(), name.length() ) == 0 &&
+         data[name.length()] == '\n' ) {
+        record = data;
+    } else if ( size > 0 ) {
+        string header = "\n\n" + name + "\n";
+        record = static_cast<const char*>(
+            memmem( data, size, header.data(), header.length() ) );
+        if ( record ) {
+            record += 2;
+        }
+    }
+
+    if ( record && version ) {
+        const char* pos = record + name.length() + 1;
+        const char* end = data + size;
+        const char* versionEnd =
+            static_cast<const char*>( memchr( pos, '\n', end - pos ) );
+        version->assign( pos, ( versionEnd ? versionEnd : end ) - pos );
+    }
+
+    if ( data ) {
+        munmap( (void*)data, size );
+    }
+    return record != 0;
+}
+
+/*!
+  the snapshot stores the installed packages and their aliases, for
+  the db and alias file it was made from, as \a stamp describes.
+  \return false if there's no db
+*/
+bool PkgDB::snapshotStamp( vector<uint32_t>& stamp ) const
+{
+    struct stat st;
+    if ( stat( ( m_installRoot + PKGDB ).c_str(), &st ) != 0 ) {
+        return false;
+    }
+    appendStat( m_installRoot + PKGDB, stamp );
+    appendStat( ALIAS_STORE, stamp );
+    return true;
+}
+
+/*!
+  open the snapshot, if it's still current; done only once
+  \return whether there's a current snapshot
+*/
+bool PkgDB::openSnapshot() const
+{
+    if ( m_snapshotChecked ) {
+        return m_snapshot != 0;
+    }
+    m_snapshotChecked = true;
 
-    fclose( fp );
+    vector<uint32_t> stamp;
+    if ( !snapshotStamp( stamp ) ) {
+        return false;
+    }
 
+    CacheFile* file = new CacheFile;
+    uint32_t rows;
+    const uint32_t* row;
+    if ( file->open( m_installRoot + SNAPSHOT ) != CacheFile::OPEN_OK ||
+         !( row = file->table( CacheFile::PKGDB_STAMP,
+                               CacheFile::PKGDB_STAMP_ROW, rows ) ) ||
+         rows != 1 || !equal( stamp.begin(), stamp.end(), row ) ||
+         !file->table( CacheFile::PKGDB_PACKAGES,
+                       CacheFile::PKGDB_PACKAGE_ROW, rows ) ||
+         !file->table( CacheFile::PKGDB_ALIASES,
+                       CacheFile::PKGDB_ALIAS_ROW, rows ) ) {
+        delete file;
+        return false;
+    }
+
+    m_snapshot = file;
     return true;
 }
 
+/*!
+  fill the aliases from the snapshot, and the packages if \a packages
+  is true
+*/
+void PkgDB::readSnapshot( bool packages ) const
+{
+    uint32_t rows;
+    const uint32_t* row;
+    if ( packages && !m_isLoaded ) {
+        row = m_snapshot->table( CacheFile::PKGDB_PACKAGES,
+                                 CacheFile::PKGDB_PACKAGE_ROW, rows );
+        for ( uint32_t i = 0; i < rows; ++i ) {
+            m_packages.insert( m_packages.end(),
+                               make_pair( m_snapshot->stringAt( row[0] ),
+                                          m_snapshot->stringAt( row[1] ) ) );
+            row += CacheFile::PKGDB_PACKAGE_ROW;
+        }
+        m_isLoaded = true;
+    }
+
+    if ( !m_aliasesLoaded ) {
+        row = m_snapshot->table( CacheFile::PKGDB_ALIASES,
+                                 CacheFile::PKGDB_ALIAS_ROW, rows );
+        for ( uint32_t i = 0; i < rows; ++i ) {
+            m_aliases[m_snapshot->stringAt( row[0] )] =
+                m_snapshot->stringAt( row[1] );
+            row += CacheFile::PKGDB_ALIAS_ROW;
+        }
+        m_aliasesLoaded = true;
+        indexAliases();
+    }
+}
+
+/*!
+  store the packages and aliases just loaded in the snapshot; it's
+  replaced atomically, so other processes can still use the old one.
+  Fails quietly if prt-get may not write it
+*/
+void PkgDB::writeSnapshot( const vector<uint32_t>& stamp ) const
+{
+    if ( stamp.empty() ) {
+        return;
+    }
+
+    CacheWriter writer;
+    vector<uint32_t> packages;
+    map<string, string>::const_iterator it = m_packages.begin();
+    for ( ; it != m_packages.end(); ++it ) {
+        packages.push_back( writer.addString( it->first ) );
+        packages.push_back( writer.addString( it->second ) );
+    }
+    vector<uint32_t> aliases;
+    for ( it = m_aliases.begin(); it != m_aliases.end(); ++it ) {
+        aliases.push_back( writer.addString( it->first ) );
+        aliases.push_back( writer.addString( it->second ) );
+    }
+
+    writer.addTable( CacheFile::PKGDB_STAMP, CacheFile::PKGDB_STAMP_ROW,
+                     stamp );
+    writer.addTable( CacheFile::PKGDB_PACKAGES,
+                     CacheFile::PKGDB_PACKAGE_ROW, packages );
+    writer.addTable( CacheFile::PKGDB_ALIASES,
+                     CacheFile::PKGDB_ALIAS_ROW, aliases );
+    writer.write( m_installRoot + SNAPSHOT );
+}
+
 /*!
   return a map of installed packages, where the key is the package name and
   the value is the version/release string
@@ -195,16 +527,12 @@ const map<string, string>& PkgDB::installedPackages()
 */
 string PkgDB::getPackageVersion( const string& name ) const
 {
-    if ( !load() ) {
+    string version;
+    if ( !findInstalled( name, &version ) ) {
         return "";
     }
 
-    map<string, string>::const_iterator it = m_packages.find( name );
-    if ( it == m_packages.end() ) {
-        return "";
-    }
-
-    return it->second;
+    return version;
 }
 
 /*!
@@ -231,12 +559,36 @@ void PkgDB::getMatchingPackages( const string& pattern,
             }
         }
     } else {
+        StringHelper::GlobPattern glob( pattern );
         for ( ; it != m_packages.end(); ++it ) {
-            // I assume fnmatch will be quite fast for "match all" (*), so
-            // I didn't add a boolean to check for this explicitely
-            if ( fnmatch( pattern.c_str(), it->first.c_str(), 0  ) == 0 ) {
+            if ( glob.match( it->first ) ) {
                 target[it->first] = it->second;
             }
         }
     }
 }
+
+/*!
+  find the installed packages owning \a file, using the index of the
+  files in the package db (see OwnerIndex)
+
+  \param file the file name, with or without leading slash
+  \param owners is set to the names of the owning packages
+  \return false if the package db can't be read
+*/
+bool PkgDB::findOwners( const string& file, vector<string>& owners ) const
+{
+    owners.clear();
+    if ( !m_ownerIndex ) {
+        m_ownerIndex = new OwnerIndex;
+        if ( !m_ownerIndex->open( m_installRoot + PKGDB,
+                                  m_installRoot + OWNER_INDEX ) ) {
+            delete m_ownerIndex;
+            m_ownerIndex = 0;
+            return false;
+        }
+    }
+
+    m_ownerIndex->findOwners( file, owners );
+    return true;
+}
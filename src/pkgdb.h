@@ -12,11 +12,15 @@
 #ifndef _PKGDB_H_
 #define _PKGDB_H_
 
+#include <stdint.h>
 #include <map>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <string>
 
+class CacheFile;
+class OwnerIndex;
 
 /*!
   \class PkgDB
@@ -28,6 +32,7 @@ class PkgDB
 {
 public:
     PkgDB( const std::string& installRoot = "" );
+    ~PkgDB();
     bool isInstalled( const std::string& name,
                       bool useAlias = false,
                       bool* isAlias = 0,
@@ -39,22 +44,46 @@ public:
     void getMatchingPackages( const std::string& pattern,
                               map<std::string,std::string>& target,
                               bool useRegex ) const;
+    bool findOwners( const std::string& file,
+                     std::vector<std::string>& owners ) const;
 
     static const std::string ALIAS_STORE;
 
 private:
+    PkgDB( const PkgDB& );
+    PkgDB& operator=( const PkgDB& );
+
     bool load() const;
+    void indexAliases() const;
+    bool findInstalled( const std::string& name,
+                        std::string* version ) const;
+    bool scanDb( const std::string& name, std::string* version ) const;
+
+    bool snapshotStamp( std::vector<uint32_t>& stamp ) const;
+    bool openSnapshot() const;
+    void readSnapshot( bool packages ) const;
+    void writeSnapshot( const std::vector<uint32_t>& stamp ) const;
 
     bool aliasExistsFor(const string& name, string& provider) const;
 
     mutable bool m_isLoaded;
     mutable std::map<std::string, std::string> m_packages;
     mutable std::map<std::string, std::string> m_aliases;
-    mutable std::map<std::string, std::vector<std::string> > m_splitAliases;
+    // the installed package providing a name, see indexAliases()
+    mutable std::unordered_map<std::string, std::string> m_providers;
+    mutable bool m_aliasesLoaded;
+
+    mutable CacheFile* m_snapshot;
+    mutable bool m_snapshotChecked;
+    mutable unsigned int m_scans;
+
+    mutable OwnerIndex* m_ownerIndex;
 
     std::string m_installRoot;
 
     static const std::string PKGDB;
+    static const std::string OWNER_INDEX;
+    static const std::string SNAPSHOT;
 };
 
 #endif /* _PKGDB_H_ */
@@ -0,0 +1,243 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        pkgfilebench.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+// Compares PkgfileParser to the line based parser it replaced, on the
+// Pkgfiles of real ports directories:
+//
+//   make pkgfilebench
+//   ./pkgfilebench [-n rounds] /usr/ports/core /usr/ports/opt ...
+//
+// Shell commands in versions are not expanded by either parser.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <time.h>
+
+#include "package.h"
+#include "pkgfileparser.h"
+#include "stringhelper.h"
+using namespace StringHelper;
+
+namespace
+{
+    /*! the line based parser formerly used by Package::parsePkgfile() */
+    void legacyParse( const string& pkgfile, PkgfileFields& fields )
+    {
+        string line;
+        string::size_type start = 0;
+        while ( start < pkgfile.length() ) {
+
+            string::size_type end = pkgfile.find( '\n', start );
+            if ( end == string::npos ) {
+                end = pkgfile.length();
+            }
+            line = stripWhiteSpace( pkgfile.substr( start, end - start ) );
+            start = end + 1;
+
+            if ( line.substr( 0, 8 ) == "version=" ) {
+                fields.version = getValueBefore( getValue( line, '=' ), '#' );
+                fields.version = stripWhiteSpace( fields.version );
+            } else if ( line.substr( 0, 8 ) == "release=" ) {
+                fields.release = getValueBefore( getValue( line, '=' ), '#' );
+                fields.release = stripWhiteSpace( fields.release );
+            } else if ( line[0] == '#' ) {
+                while ( !line.empty() &&
+                        ( line[0] == '#' || line[0] == ' ' ||
+                          line[0] == '\t' ) ) {
+                    line = line.substr( 1 );
+                }
+                string::size_type pos = line.find( ':' );
+                if ( pos != string::npos ) {
+                    if ( startsWithNoCase( line, "desc" ) ) {
+                        fields.description =
+                            stripWhiteSpace( getValue( line, ':' ) );
+                    } else if ( startsWithNoCase( line, "pack" ) ) {
+                        fields.packager =
+                            stripWhiteSpace( getValue( line, ':' ) );
+                    } else if ( startsWithNoCase( line, "maint" ) ) {
+                        fields.maintainer =
+                            stripWhiteSpace( getValue( line, ':' ) );
+                    } else if ( startsWithNoCase( line, "url" ) ) {
+                        fields.url = stripWhiteSpace( getValue( line, ':' ) );
+                    } else if ( startsWithNoCase( line, "dep" ) ) {
+                        string depends =
+                            stripWhiteSpace( getValue( line, ':' ) );
+                        replaceAll( depends, " ", "," );
+                        replaceAll( depends, ",,", "," );
+                        fields.depends = depends;
+                    }
+                }
+            }
+        }
+    }
+
+    /*! the way Package::readPkgfile() used to read a Pkgfile */
+    bool legacyRead( const string& fileName, string& pkgfile )
+    {
+        FILE* fp = fopen( fileName.c_str(), "r" );
+        if ( fp == NULL ) {
+            return false;
+        }
+
+        pkgfile.clear();
+        char input[BUFSIZ];
+        size_t length;
+        while ( ( length = fread( input, 1, BUFSIZ, fp ) ) > 0 ) {
+            pkgfile.append( input, length );
+        }
+        fclose( fp );
+        return true;
+    }
+
+    double now()
+    {
+        struct timespec ts;
+        clock_gettime( CLOCK_MONOTONIC, &ts );
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    bool operator!=( const PkgfileFields& f1, const PkgfileFields& f2 )
+    {
+        return f1.version != f2.version ||
+            f1.release != f2.release ||
+            f1.description != f2.description ||
+            f1.depends != f2.depends ||
+            f1.url != f2.url ||
+            f1.packager != f2.packager ||
+            f1.maintainer != f2.maintainer;
+    }
+
+    void findPkgfiles( const string& path, vector<string>& files )
+    {
+        DIR* d = opendir( path.c_str() );
+        if ( !d ) {
+            cerr << "pkgfilebench: can't open " << path << endl;
+            return;
+        }
+
+        struct dirent* de;
+        while ( ( de = readdir( d ) ) != NULL ) {
+            if ( de->d_name[0] == '.' ) {
+                continue;
+            }
+            string fileName = path + "/" + de->d_name + "/Pkgfile";
+            struct stat buf;
+            if ( stat( fileName.c_str(), &buf ) == 0 ) {
+                files.push_back( fileName );
+            }
+        }
+        closedir( d );
+    }
+
+    void printResult( const char* what, double legacy, double current,
+                      int rounds )
+    {
+        printf( "%-14s %10.2f ms %10.2f ms %8.2fx\n", what,
+                legacy * 1000 / rounds, current * 1000 / rounds,
+                current > 0 ? legacy / current : 0.0 );
+    }
+}
+
+int main( int argc, char** argv )
+{
+    int rounds = 10;
+    vector<string> files;
+    for ( int i = 1; i < argc; ++i ) {
+        if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) {
+            rounds = atoi( argv[++i] );
+        } else {
+            findPkgfiles( argv[i], files );
+        }
+    }
+    if ( files.empty() || rounds < 1 ) {
+        cerr << "usage: pkgfilebench [-n rounds] <ports dir> ..." << endl;
+        return 1;
+    }
+
+    vector<string> contents( files.size() );
+    for ( size_t i = 0; i < files.size(); ++i ) {
+        legacyRead( files[i], contents[i] );
+    }
+
+    size_t mismatches = 0;
+    for ( size_t i = 0; i < files.size(); ++i ) {
+        PkgfileFields legacy;
+        PkgfileFields current;
+        legacyParse( contents[i], legacy );
+        PkgfileParser::parse( contents[i].data(), contents[i].length(),
+                              current, Package::PKGFILE_FIELDS );
+        if ( legacy != current ) {
+            cerr << "pkgfilebench: different result for " << files[i]
+                 << endl;
+            ++mismatches;
+        }
+    }
+
+    double legacyReadTime = 0;
+    double currentReadTime = 0;
+    double legacyParseTime = 0;
+    double currentParseTime = 0;
+    for ( int round = 0; round < rounds; ++round ) {
+        string pkgfile;
+        double start = now();
+        for ( size_t i = 0; i < files.size(); ++i ) {
+            PkgfileFields fields;
+            legacyRead( files[i], pkgfile );
+            legacyParse( pkgfile, fields );
+        }
+        double middle = now();
+        for ( size_t i = 0; i < files.size(); ++i ) {
+            PkgfileFields fields;
+            PkgfileParser::readFile( files[i], pkgfile );
+            PkgfileParser::parse( pkgfile.data(), pkgfile.length(),
+                                  fields, Package::PKGFILE_FIELDS );
+        }
+        double end = now();
+        legacyReadTime += middle - start;
+        currentReadTime += end - middle;
+
+        start = now();
+        for ( size_t i = 0; i < files.size(); ++i ) {
+            PkgfileFields fields;
+            legacyParse( contents[i], fields );
+        }
+        middle = now();
+        for ( size_t i = 0; i < files.size(); ++i ) {
+            PkgfileFields fields;
+            PkgfileParser::parse( contents[i].data(), contents[i].length(),
+                                  fields, Package::PKGFILE_FIELDS );
+        }
+        end = now();
+        legacyParseTime += middle - start;
+        currentParseTime += end - middle;
+    }
+
+    printf( "%zu Pkgfiles, %d rounds, time per round\n",
+            files.size(), rounds );
+    printf( "%-14s %13s %13s %9s\n", "", "legacy", "new", "speedup" );
+    printResult( "read + parse", legacyReadTime, currentReadTime, rounds );
+    printResult( "parse only", legacyParseTime, currentParseTime, rounds );
+
+    if ( mismatches ) {
+        printf( "%zu Pkgfiles parsed differently\n", mismatches );
+        return 1;
+    }
+    return 0;
+}
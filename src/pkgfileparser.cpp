@@ -0,0 +1,223 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        pkgfileparser.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+using namespace std;
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "pkgfileparser.h"
+#include "package.h"
+
+namespace
+{
+    inline bool isSpace( char c )
+    {
+        return isspace( (unsigned char)c );
+    }
+
+    /*! move \a begin and \a end so [begin, end) has no outer white space */
+    void strip( const char*& begin, const char*& end )
+    {
+        while ( begin < end && isSpace( *begin ) ) {
+            ++begin;
+        }
+        while ( end > begin && isSpace( *( end - 1 ) ) ) {
+            --end;
+        }
+    }
+
+    bool startsWith( const char* begin, const char* end,
+                     const char* prefix, size_t length )
+    {
+        return (size_t)( end - begin ) >= length &&
+            memcmp( begin, prefix, length ) == 0;
+    }
+
+    bool startsWithNoCase( const char* begin, const char* end,
+                           const char* prefix, size_t length )
+    {
+        return (size_t)( end - begin ) >= length &&
+            strncasecmp( begin, prefix, length ) == 0;
+    }
+
+    /*!
+      store the value of a 'version=' or 'release=' line, which starts at
+      \a begin and ends at a comment or the end of the line
+    */
+    void assignVariable( const char* begin, const char* end,
+                         string& target )
+    {
+        const char* comment =
+            static_cast<const char*>( memchr( begin, '#', end - begin ) );
+        if ( comment ) {
+            end = comment;
+        }
+        strip( begin, end );
+        target.assign( begin, end - begin );
+    }
+
+    /*!
+      store the dependency list [begin, end), using single commas as
+      separators
+    */
+    void assignDepends( const char* begin, const char* end,
+                        string& target )
+    {
+        target.clear();
+        target.reserve( end - begin );
+        for ( ; begin < end; ++begin ) {
+            char c = *begin == ' ' ? ',' : *begin;
+            if ( c != ',' || target.empty() ||
+                 target[target.length()-1] != ',' ) {
+                target += c;
+            }
+        }
+    }
+}
+
+/*!
+  parse the Pkgfile \a data of \a length bytes into \a fields. Fields
+  which are not found in \a data are left untouched; when a field is
+  given several times, the last one wins.
+
+  Only the groups of fields in \a groups (see Package::FieldGroup) are
+  parsed; comment lines are skipped unless a group needs them. The whole
+  file is always scanned, so that a later version or release assignment
+  overrides an earlier one.
+*/
+void PkgfileParser::parse( const char* data, size_t length,
+                           PkgfileFields& fields, unsigned int groups )
+{
+    const bool comments =
+        ( groups & ( Package::HEADER_FIELDS | Package::DEPENDS_FIELD ) ) != 0;
+
+    const char* pos = data;
+    const char* dataEnd = data + length;
+    while ( pos < dataEnd ) {
+        const char* begin = pos;
+        const char* end =
+            static_cast<const char*>( memchr( pos, '\n', dataEnd - pos ) );
+        if ( !end ) {
+            end = dataEnd;
+        }
+        pos = end + 1;
+
+        strip( begin, end );
+        if ( begin == end ) {
+            continue;
+        }
+
+        if ( startsWith( begin, end, "version=", 8 ) ) {
+            if ( groups & Package::VERSION_FIELDS ) {
+                assignVariable( begin + 8, end, fields.version );
+            }
+        } else if ( startsWith( begin, end, "release=", 8 ) ) {
+            if ( groups & Package::VERSION_FIELDS ) {
+                assignVariable( begin + 8, end, fields.release );
+            }
+        } else if ( *begin == '#' && comments ) {
+            parseComment( begin, end, fields, groups );
+        }
+    }
+}
+
+/*!
+  parse the comment line [begin, end) of a Pkgfile
+*/
+void PkgfileParser::parseComment( const char* begin, const char* end,
+                                  PkgfileFields& fields,
+                                  unsigned int groups )
+{
+    while ( begin < end &&
+            ( *begin == '#' || *begin == ' ' || *begin == '\t' ) ) {
+        ++begin;
+    }
+    const char* colon =
+        static_cast<const char*>( memchr( begin, ':', end - begin ) );
+    if ( !colon ) {
+        return;
+    }
+
+    const char* value = colon + 1;
+    const char* valueEnd = end;
+    strip( value, valueEnd );
+    size_t valueLength = valueEnd - value;
+
+    bool header = ( groups & Package::HEADER_FIELDS ) != 0;
+    if ( startsWithNoCase( begin, end, "desc", 4 ) ) {
+        if ( header ) {
+            fields.description.assign( value, valueLength );
+        }
+    } else if ( startsWithNoCase( begin, end, "pack", 4 ) ) {
+        if ( header ) {
+            fields.packager.assign( value, valueLength );
+        }
+    } else if ( startsWithNoCase( begin, end, "maint", 5 ) ) {
+        if ( header ) {
+            fields.maintainer.assign( value, valueLength );
+        }
+    } else if ( startsWithNoCase( begin, end, "url", 3 ) ) {
+        if ( header ) {
+            fields.url.assign( value, valueLength );
+        }
+    } else if ( startsWithNoCase( begin, end, "dep", 3 ) ) {
+        if ( groups & Package::DEPENDS_FIELD ) {
+            assignDepends( value, valueEnd, fields.depends );
+        }
+    }
+}
+
+/*!
+  read \a fileName into \a contents. A single read() is enough unless
+  the file grows while it's read.
+  \return whether the file could be opened
+*/
+bool PkgfileParser::readFile( const string& fileName, string& contents )
+{
+    int fd = open( fileName.c_str(), O_RDONLY | O_CLOEXEC );
+    if ( fd == -1 ) {
+        return false;
+    }
+
+    // one byte more than the file size, so a short read shows the end
+    // of the file was reached
+    size_t capacity = BUFSIZ;
+    struct stat st;
+    if ( fstat( fd, &st ) == 0 && st.st_size > 0 ) {
+        capacity = st.st_size + 1;
+    }
+
+    size_t length = 0;
+    contents.resize( capacity );
+    for ( ;; ) {
+        ssize_t count = read( fd, &contents[length], capacity - length );
+        if ( count <= 0 ) {
+            break;
+        }
+        length += count;
+        if ( length < capacity ) {
+            break;
+        }
+        capacity *= 2;
+        contents.resize( capacity );
+    }
+    contents.resize( length );
+
+    close( fd );
+    return true;
+}
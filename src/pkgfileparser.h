@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        pkgfileparser.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _PKGFILEPARSER_H_
+#define _PKGFILEPARSER_H_
+
+#include <cstddef>
+#include <string>
+
+/*!
+  the fields prt-get reads from a Pkgfile; the version is stored as
+  written, shell commands are not expanded
+*/
+struct PkgfileFields
+{
+    std::string version;
+    std::string release;
+    std::string description;
+    std::string depends;
+    std::string url;
+    std::string packager;
+    std::string maintainer;
+};
+
+/*!
+  \class PkgfileParser
+  \brief parser for the header and version of a Pkgfile
+
+  The contents are scanned once, without copying lines; only the values
+  found end up in new strings.
+*/
+class PkgfileParser
+{
+public:
+    static void parse( const char* data, size_t length,
+                       PkgfileFields& fields, unsigned int groups );
+    static bool readFile( const std::string& fileName,
+                          std::string& contents );
+
+private:
+    static void parseComment( const char* begin, const char* end,
+                              PkgfileFields& fields, unsigned int groups );
+};
+
+#endif /* _PKGFILEPARSER_H_ */
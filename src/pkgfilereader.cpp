@@ -0,0 +1,499 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        pkgfilereader.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <config.h>
+
+#include <cerrno>
+#include <cstring>
+using namespace std;
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+
+#include "pkgfilereader.h"
+#include "package.h"
+
+
+PortFiles::PortFiles()
+    : valid( false ),
+      hasReadme( false ),
+      hasPreInstall( false ),
+      hasPostInstall( false )
+{
+}
+
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup)
+
+namespace
+{
+    // ports in flight; each has up to four requests (open or read, and
+    // three stats) queued at a time
+    const unsigned int MAX_PORTS = 48;
+    const unsigned int RING_ENTRIES = 256;
+
+    // initial read size; most Pkgfiles are a lot smaller
+    const size_t READ_SIZE = 16384;
+
+    // the part of user_data below the port slot
+    enum Request {
+        OPEN,
+        READ,
+        STAT_README,
+        STAT_PRE_INSTALL,
+        STAT_POST_INSTALL,
+        REQUEST_BITS = 3
+    };
+
+    const char* const STAT_FILES[] = {
+        "/README", "/pre-install", "/post-install"
+    };
+
+    /*!
+      the state of one port being read
+    */
+    struct Slot
+    {
+        size_t index;
+        string pkgfileName;
+        string statNames[3];
+        struct statx statBuf[3];
+        bool found[3];
+
+        int fd;
+        vector<char> buffer;
+        size_t size;
+
+        int pending;
+        bool failed;
+    };
+
+    /*!
+      a minimal io_uring, set up with the plain system calls
+    */
+    class Ring
+    {
+    public:
+        Ring();
+        ~Ring();
+
+        bool init( unsigned int entries );
+        struct io_uring_sqe* nextSqe();
+        bool submitAndWait();
+        bool nextCqe( struct io_uring_cqe& cqe );
+
+    private:
+        int m_fd;
+        unsigned int m_toSubmit;
+
+        void* m_sqRing;
+        size_t m_sqRingSize;
+        void* m_cqRing;
+        size_t m_cqRingSize;
+        struct io_uring_sqe* m_sqes;
+        size_t m_sqesSize;
+
+        unsigned* m_sqHead;
+        unsigned* m_sqTail;
+        unsigned m_sqMask;
+        unsigned m_sqEntries;
+        unsigned* m_sqArray;
+
+        unsigned* m_cqHead;
+        unsigned* m_cqTail;
+        unsigned m_cqMask;
+        struct io_uring_cqe* m_cqes;
+    };
+
+    // set once io_uring turned out not to work, to avoid trying again
+    bool ringUnavailable = false;
+}
+
+Ring::Ring()
+    : m_fd( -1 ),
+      m_toSubmit( 0 ),
+      m_sqRing( MAP_FAILED ),
+      m_sqRingSize( 0 ),
+      m_cqRing( MAP_FAILED ),
+      m_cqRingSize( 0 ),
+      m_sqes( (struct io_uring_sqe*)MAP_FAILED ),
+      m_sqesSize( 0 )
+{
+}
+
+Ring::~Ring()
+{
+    if ( m_sqes != MAP_FAILED ) {
+        munmap( m_sqes, m_sqesSize );
+    }
+    if ( m_cqRing != MAP_FAILED && m_cqRing != m_sqRing ) {
+        munmap( m_cqRing, m_cqRingSize );
+    }
+    if ( m_sqRing != MAP_FAILED ) {
+        munmap( m_sqRing, m_sqRingSize );
+    }
+    if ( m_fd != -1 ) {
+        close( m_fd );
+    }
+}
+
+/*!
+  create the ring and map its queues
+  \return false if io_uring is not available
+*/
+bool Ring::init( unsigned int entries )
+{
+    struct io_uring_params params;
+    memset( &params, 0, sizeof( params ) );
+    m_fd = syscall( __NR_io_uring_setup, entries, &params );
+    if ( m_fd < 0 ) {
+        m_fd = -1;
+        return false;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+    m_cqRingSize = params.cq_off.cqes +
+        params.cq_entries * sizeof( struct io_uring_cqe );
+    bool singleMap = ( params.features & IORING_FEAT_SINGLE_MMAP ) != 0;
+    if ( singleMap && m_cqRingSize > m_sqRingSize ) {
+        m_sqRingSize = m_cqRingSize;
+    }
+
+    m_sqRing = mmap( 0, m_sqRingSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING );
+    if ( m_sqRing == MAP_FAILED ) {
+        return false;
+    }
+    if ( singleMap ) {
+        m_cqRing = m_sqRing;
+    } else {
+        m_cqRing = mmap( 0, m_cqRingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING );
+        if ( m_cqRing == MAP_FAILED ) {
+            return false;
+        }
+    }
+
+    m_sqesSize = params.sq_entries * sizeof( struct io_uring_sqe );
+    m_sqes = (struct io_uring_sqe*)mmap( 0, m_sqesSize,
+                                         PROT_READ | PROT_WRITE,
+                                         MAP_SHARED | MAP_POPULATE,
+                                         m_fd, IORING_OFF_SQES );
+    if ( m_sqes == MAP_FAILED ) {
+        return false;
+    }
+
+    char* sq = static_cast<char*>( m_sqRing );
+    m_sqHead = (unsigned*)( sq + params.sq_off.head );
+    m_sqTail = (unsigned*)( sq + params.sq_off.tail );
+    m_sqMask = *(unsigned*)( sq + params.sq_off.ring_mask );
+    m_sqEntries = *(unsigned*)( sq + params.sq_off.ring_entries );
+    m_sqArray = (unsigned*)( sq + params.sq_off.array );
+
+    char* cq = static_cast<char*>( m_cqRing );
+    m_cqHead = (unsigned*)( cq + params.cq_off.head );
+    m_cqTail = (unsigned*)( cq + params.cq_off.tail );
+    m_cqMask = *(unsigned*)( cq + params.cq_off.ring_mask );
+    m_cqes = (struct io_uring_cqe*)( cq + params.cq_off.cqes );
+
+    return true;
+}
+
+/*!
+  \return a cleared submission queue entry, or 0 if the queue is full
+*/
+struct io_uring_sqe* Ring::nextSqe()
+{
+    unsigned head = __atomic_load_n( m_sqHead, __ATOMIC_ACQUIRE );
+    unsigned tail = *m_sqTail;
+    if ( tail - head >= m_sqEntries ) {
+        return 0;
+    }
+
+    unsigned index = tail & m_sqMask;
+    struct io_uring_sqe* sqe = &m_sqes[index];
+    memset( sqe, 0, sizeof( *sqe ) );
+    m_sqArray[index] = index;
+    __atomic_store_n( m_sqTail, tail + 1, __ATOMIC_RELEASE );
+    ++m_toSubmit;
+
+    return sqe;
+}
+
+/*!
+  submit the queued entries and wait for at least one completion
+  \return false on errors
+*/
+bool Ring::submitAndWait()
+{
+    for ( ;; ) {
+        int ret = syscall( __NR_io_uring_enter, m_fd, m_toSubmit, 1,
+                           IORING_ENTER_GETEVENTS, 0, 0 );
+        if ( ret >= 0 ) {
+            m_toSubmit -= ret;
+            return true;
+        }
+        if ( errno != EINTR && errno != EAGAIN && errno != EBUSY ) {
+            return false;
+        }
+    }
+}
+
+/*!
+  take the next completion off the queue
+  \return false if there's none
+*/
+bool Ring::nextCqe( struct io_uring_cqe& cqe )
+{
+    unsigned head = *m_cqHead;
+    if ( head == __atomic_load_n( m_cqTail, __ATOMIC_ACQUIRE ) ) {
+        return false;
+    }
+
+    cqe = m_cqes[head & m_cqMask];
+    __atomic_store_n( m_cqHead, head + 1, __ATOMIC_RELEASE );
+    return true;
+}
+
+
+namespace
+{
+    /*!
+      queue a request for \a slot
+      \return the entry to be filled in, or 0 if the queue is full
+    */
+    struct io_uring_sqe* queue( Ring& ring, Slot& slot, size_t slotIndex,
+                                int request )
+    {
+        struct io_uring_sqe* sqe = ring.nextSqe();
+        if ( !sqe ) {
+            slot.failed = true;
+            return 0;
+        }
+        sqe->user_data = ( slotIndex << REQUEST_BITS ) | request;
+        ++slot.pending;
+        return sqe;
+    }
+
+    void queueRead( Ring& ring, Slot& slot, size_t slotIndex )
+    {
+        struct io_uring_sqe* sqe = queue( ring, slot, slotIndex, READ );
+        if ( sqe ) {
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = slot.fd;
+            sqe->addr = (unsigned long)( &slot.buffer[0] + slot.size );
+            sqe->len = slot.buffer.size() - slot.size;
+            sqe->off = slot.size;
+        }
+    }
+
+    void startPort( Ring& ring, Slot& slot, size_t slotIndex,
+                    size_t index, const Package* package, bool statFiles )
+    {
+        string dir = package->path() + "/" + package->name();
+        slot.index = index;
+        slot.pkgfileName = dir + "/Pkgfile";
+        slot.fd = -1;
+        slot.size = 0;
+        slot.pending = 0;
+        slot.failed = false;
+
+        struct io_uring_sqe* sqe = queue( ring, slot, slotIndex, OPEN );
+        if ( sqe ) {
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (unsigned long)slot.pkgfileName.c_str();
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        }
+
+        for ( int i = 0; i < 3; ++i ) {
+            slot.found[i] = false;
+            if ( !statFiles ) {
+                continue;
+            }
+            slot.statNames[i] = dir + STAT_FILES[i];
+            sqe = queue( ring, slot, slotIndex, STAT_README + i );
+            if ( sqe ) {
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (unsigned long)slot.statNames[i].c_str();
+                sqe->len = STATX_TYPE;
+                sqe->off = (unsigned long)&slot.statBuf[i];
+            }
+        }
+    }
+
+    /*!
+      handle the completion of \a request of \a slot
+      \return false if io_uring turned out not to support the request
+    */
+    bool complete( Ring& ring, Slot& slot, size_t slotIndex,
+                   int request, int result )
+    {
+        int pending = --slot.pending;
+
+        switch ( request ) {
+        case OPEN:
+            if ( result < 0 ) {
+                // left to Package::load(), which handles errors
+                slot.failed = true;
+            } else {
+                slot.fd = result;
+                slot.buffer.resize( READ_SIZE );
+                queueRead( ring, slot, slotIndex );
+            }
+            break;
+        case READ:
+            if ( result < 0 ) {
+                slot.failed = true;
+            } else {
+                size_t requested = slot.buffer.size() - slot.size;
+                slot.size += result;
+                if ( (size_t)result == requested && !slot.failed ) {
+                    // there might be more
+                    slot.buffer.resize( slot.buffer.size() * 2 );
+                    queueRead( ring, slot, slotIndex );
+                }
+            }
+            break;
+        default:
+            if ( result == 0 ) {
+                slot.found[request - STAT_README] = true;
+            } else if ( result != -ENOENT && result != -ENOTDIR ) {
+                slot.failed = true;
+            }
+            break;
+        }
+
+        // done with the Pkgfile unless another read is pending
+        if ( slot.fd != -1 && request <= READ && slot.pending == pending ) {
+            close( slot.fd );
+            slot.fd = -1;
+        }
+
+        // older kernels don't know all requests
+        return result != -EINVAL && result != -EOPNOTSUPP;
+    }
+}
+
+/*!
+  read the Pkgfiles of \a packages and check for their README and
+  install scripts.
+  \param packages the packages to read
+  \param statFiles whether to check for README and install scripts at
+                   all; if not, the flags in \a files are false
+  \param files receives the files of each package; entries which are
+               not valid have to be loaded using Package::load()
+  \return false if io_uring is not available; \a files is not changed
+*/
+bool PkgfileReader::readAll( const vector<const Package*>& packages,
+                             vector<PortFiles>& files,
+                             bool statFiles )
+{
+    if ( ringUnavailable ) {
+        return false;
+    }
+
+    Ring ring;
+    if ( !ring.init( RING_ENTRIES ) ) {
+        ringUnavailable = true;
+        return false;
+    }
+
+    files.clear();
+    files.resize( packages.size() );
+
+    vector<Slot>* slots = new vector<Slot>( MAX_PORTS );
+    vector<size_t> freeSlots;
+    for ( size_t i = MAX_PORTS; i > 0; --i ) {
+        freeSlots.push_back( i - 1 );
+    }
+
+    size_t next = 0;
+    size_t active = 0;
+    bool supported = true;
+    for ( ;; ) {
+        while ( supported && next < packages.size() && !freeSlots.empty() ) {
+            size_t slotIndex = freeSlots.back();
+            freeSlots.pop_back();
+            startPort( ring, (*slots)[slotIndex], slotIndex,
+                       next, packages[next], statFiles );
+            ++next;
+            ++active;
+        }
+
+        if ( active == 0 ) {
+            break;
+        }
+
+        if ( !ring.submitAndWait() ) {
+            // requests might still be running; the slots are leaked
+            // rather than having the kernel write to freed memory
+            ringUnavailable = true;
+            files.assign( packages.size(), PortFiles() );
+            return true;
+        }
+
+        struct io_uring_cqe cqe;
+        while ( ring.nextCqe( cqe ) ) {
+            size_t slotIndex = cqe.user_data >> REQUEST_BITS;
+            int request = cqe.user_data & ( ( 1 << REQUEST_BITS ) - 1 );
+            Slot& slot = (*slots)[slotIndex];
+
+            if ( !complete( ring, slot, slotIndex, request, cqe.res ) ) {
+                supported = false;
+                ringUnavailable = true;
+            }
+            if ( slot.pending > 0 ) {
+                continue;
+            }
+
+            if ( !slot.failed ) {
+                PortFiles& port = files[slot.index];
+                port.valid = true;
+                port.pkgfile.assign( &slot.buffer[0], slot.size );
+                port.hasReadme = slot.found[0];
+                port.hasPreInstall = slot.found[1];
+                port.hasPostInstall = slot.found[2];
+            }
+            slot.buffer.clear();
+
+            freeSlots.push_back( slotIndex );
+            --active;
+        }
+    }
+
+    delete slots;
+    return true;
+}
+
+#else
+
+/*!
+  io_uring is not available on this system
+  \return false
+*/
+bool PkgfileReader::readAll( const vector<const Package*>& packages,
+                             vector<PortFiles>& files,
+                             bool statFiles )
+{
+    return false;
+}
+
+#endif
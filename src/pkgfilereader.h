@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        pkgfilereader.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _PKGFILEREADER_H_
+#define _PKGFILEREADER_H_
+
+#include <string>
+#include <vector>
+
+class Package;
+
+/*!
+  the files of a port required by Package::load()
+*/
+struct PortFiles
+{
+    PortFiles();
+
+    bool valid;     /*!< false if the port has to be loaded the usual way */
+    std::string pkgfile;
+    bool hasReadme;
+    bool hasPreInstall;
+    bool hasPostInstall;
+};
+
+/*!
+  \class PkgfileReader
+  \brief reads the Pkgfiles of many ports at once
+
+  Uses io_uring where available to keep many opens, stats and reads in
+  flight at the same time, rather than waiting for each of them in
+  turn. This matters most for cold caches and network file systems.
+*/
+class PkgfileReader
+{
+public:
+    static bool readAll( const std::vector<const Package*>& packages,
+                         std::vector<PortFiles>& files,
+                         bool statFiles );
+};
+
+#endif /* _PKGFILEREADER_H_ */
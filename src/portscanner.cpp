@@ -0,0 +1,251 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        portscanner.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include <climits>
+using namespace std;
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fnmatch.h>
+
+#include "portscanner.h"
+#include "package.h"
+
+namespace
+{
+    const char PKGFILE[] = "/Pkgfile";
+
+    /*!
+      write "name/Pkgfile" to \a buf, which has to have a size of at
+      least NAME_MAX + sizeof( PKGFILE )
+      \return false if \a name is not a valid directory entry name
+    */
+    bool pkgfilePath( const char* name, char* buf )
+    {
+        size_t length = strlen( name );
+        if ( length > NAME_MAX ) {
+            return false;
+        }
+        memcpy( buf, name, length );
+        memcpy( buf + length, PKGFILE, sizeof( PKGFILE ) );
+        return true;
+    }
+}
+
+PortFilter::PortFilter()
+    : m_active( false )
+{
+}
+
+/*!
+  parse \a filter, the part after the colon of a prtdir line
+*/
+void PortFilter::parse( const string& filter )
+{
+    m_active = false;
+    m_nameSet.clear();
+    m_names.clear();
+    m_patterns.clear();
+
+    string::size_type pos = 0;
+    while ( pos < filter.length() ) {
+        pos = filter.find_first_not_of( ", \t\n\r", pos );
+        if ( pos == string::npos ) {
+            break;
+        }
+        string::size_type end = filter.find_first_of( ", \t\n\r", pos );
+        if ( end == string::npos ) {
+            end = filter.length();
+        }
+
+        string name = filter.substr( pos, end - pos );
+        if ( name.find_first_of( "*?[" ) != string::npos ) {
+            m_patterns.push_back( name );
+        } else if ( m_nameSet.insert( name ).second ) {
+            m_names.push_back( name );
+        }
+        pos = end;
+    }
+
+    // a filter which doesn't list any valid port still excludes all
+    m_active = filter.find_first_not_of( " \t\n\r" ) != string::npos;
+}
+
+/*! \return whether there's a filter at all */
+bool PortFilter::isActive() const
+{
+    return m_active;
+}
+
+/*! \return whether the filter contains shell wildcards */
+bool PortFilter::hasPatterns() const
+{
+    return !m_patterns.empty();
+}
+
+/*! \return whether port \a name passes the filter */
+bool PortFilter::matches( const string& name ) const
+{
+    if ( !m_active || m_nameSet.find( name ) != m_nameSet.end() ) {
+        return true;
+    }
+
+    vector<string>::const_iterator it = m_patterns.begin();
+    for ( ; it != m_patterns.end(); ++it ) {
+        if ( fnmatch( it->c_str(), name.c_str(), 0 ) == 0 ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*! \return the ports listed without wildcards */
+const vector<string>& PortFilter::names() const
+{
+    return m_names;
+}
+
+
+PortScanner::PortScanner()
+    : m_fd( -1 ),
+      m_dir( 0 )
+{
+}
+
+PortScanner::~PortScanner()
+{
+    close();
+}
+
+/*!
+  open the ports directory \a path
+  \return whether \a path could be opened
+*/
+bool PortScanner::open( const string& path )
+{
+    close();
+
+    int fd = ::open( path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+    if ( fd == -1 ) {
+        return false;
+    }
+
+    // the stream owns fd from now on
+    m_dir = fdopendir( fd );
+    if ( !m_dir ) {
+        ::close( fd );
+        return false;
+    }
+    m_fd = fd;
+
+    return true;
+}
+
+void PortScanner::close()
+{
+    if ( m_dir ) {
+        closedir( m_dir );
+        m_dir = 0;
+        m_fd = -1;
+    }
+}
+
+/*!
+  \return the name of the next entry which could be a port, 0 at the end
+  of the directory. The name is valid until next() is called again.
+*/
+const char* PortScanner::next()
+{
+    if ( !m_dir ) {
+        return 0;
+    }
+
+    struct dirent* de;
+    while ( ( de = readdir( m_dir ) ) != NULL ) {
+        const char* name = de->d_name;
+        if ( name[0] == '.' &&
+             ( name[1] == '\0' || ( name[1] == '.' && name[2] == '\0' ) ) ) {
+            continue;
+        }
+
+        // symlinks and file systems without d_type have to be checked
+        // later on
+        if ( de->d_type == DT_DIR ||
+             de->d_type == DT_LNK ||
+             de->d_type == DT_UNKNOWN ) {
+            return name;
+        }
+    }
+
+    return 0;
+}
+
+/*!
+  get the entries which could be ports passing \a filter. If \a filter
+  doesn't contain wildcards, the directory isn't read at all, so this
+  only depends on the size of the filter
+*/
+void PortScanner::candidates( const PortFilter& filter,
+                              vector<string>& names )
+{
+    if ( filter.isActive() && !filter.hasPatterns() ) {
+        vector<string>::const_iterator it = filter.names().begin();
+        for ( ; it != filter.names().end(); ++it ) {
+            if ( *it != "." && *it != ".." &&
+                 it->find( '/' ) == string::npos ) {
+                names.push_back( *it );
+            }
+        }
+        return;
+    }
+
+    const char* entry;
+    while ( ( entry = next() ) != 0 ) {
+        if ( filter.matches( entry ) ) {
+            names.push_back( entry );
+        }
+    }
+}
+
+/*!
+  \return whether entry \a name of the ports directory contains a Pkgfile
+*/
+bool PortScanner::isPort( const char* name ) const
+{
+    char path[NAME_MAX + sizeof( PKGFILE )];
+    struct stat buf;
+    return pkgfilePath( name, path ) &&
+        fstatat( m_fd, path, &buf, 0 ) == 0;
+}
+
+/*!
+  read the fingerprint of the port in entry \a name of the ports directory
+  \return false if \a name is not a port
+*/
+bool PortScanner::readFingerprint( const char* name,
+                                   PortFingerprint& fingerprint ) const
+{
+    char path[NAME_MAX + sizeof( PKGFILE )];
+    struct stat dirStat;
+    struct stat pkgfileStat;
+    if ( !pkgfilePath( name, path ) ||
+         fstatat( m_fd, path, &pkgfileStat, 0 ) != 0 ||
+         fstatat( m_fd, name, &dirStat, 0 ) != 0 ) {
+        return false;
+    }
+
+    fingerprint.set( dirStat, pkgfileStat );
+    return true;
+}
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        portscanner.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _PORTSCANNER_H_
+#define _PORTSCANNER_H_
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <dirent.h>
+
+struct PortFingerprint;
+
+/*!
+  \class PortFilter
+  \brief the list of ports to be used from a ports directory
+
+  The ports are separated by commas, spaces or tabs, and may contain
+  shell wildcards.
+*/
+class PortFilter
+{
+public:
+    PortFilter();
+
+    void parse( const std::string& filter );
+
+    bool isActive() const;
+    bool hasPatterns() const;
+    bool matches( const std::string& name ) const;
+    const std::vector<std::string>& names() const;
+
+private:
+    bool m_active;
+    std::unordered_set<std::string> m_nameSet;
+    std::vector<std::string> m_names;
+    std::vector<std::string> m_patterns;
+};
+
+/*!
+  \class PortScanner
+  \brief lists the ports in a ports directory
+
+  The ports directory is opened once, and all lookups are done relative
+  to it, so no paths have to be built or resolved for the single
+  entries. Entries which are known not to be directories are skipped
+  without calling stat().
+*/
+class PortScanner
+{
+public:
+    PortScanner();
+    ~PortScanner();
+
+    bool open( const std::string& path );
+    void close();
+
+    const char* next();
+    void candidates( const PortFilter& filter,
+                     std::vector<std::string>& names );
+    bool isPort( const char* name ) const;
+    bool readFingerprint( const char* name,
+                          PortFingerprint& fingerprint ) const;
+
+private:
+    int m_fd;
+    DIR* m_dir;
+};
+
+#endif /* _PORTSCANNER_H_ */
@@ -35,7 +35,9 @@ using namespace std;
 #include "stringhelper.h"
 #include "versioncomparator.h"
 #include "file.h"
+#include "footprintindex.h"
 #include "process.h"
+#include "shellevaluator.h"
 #include "datafileparser.h"
 using namespace StringHelper;
 
@@ -46,6 +48,14 @@ using VersionComparator::LESS;
 using VersionComparator::EQUAL;
 using VersionComparator::UNDEFINED;
 
+namespace
+{
+    bool lessByName( const Package* p1, const Package* p2 )
+    {
+        return p1->name() < p2->name();
+    }
+}
+
 const string PrtGet::CONF_FILE = SYSCONFDIR"/prt-get.conf";
 const string PrtGet::DEFAULT_CACHE_FILE = LOCALSTATEDIR"/lib/pkg/prt-get.cache";
 
@@ -124,6 +134,8 @@ void PrtGet::printUsage()
          << endl;
     cout << "  current  <port>            print installed version of port"
          << endl;
+    cout << "  owner    <file1 file2...>  print installed packages owning "
+         << "files" << endl;
 
     cout << "\nDIFFERENCES / CHECK FOR UPDATES" << endl;
     cout << "  diff     <port1 port2...>  list outdated packages (or check "
@@ -163,6 +175,9 @@ void PrtGet::printUsage()
          << "name or description" << endl;
     cout << "  fsearch <pattern>  show file names in footprints matching "
          << "'pattern'" << endl;
+    cout << "          where opt can be:" << endl;
+    cout << "                --reindex      update the footprint index first"
+         << endl;
 
     cout << "\nINSTALL, UPDATE and REMOVAL" << endl;
     cout << "  install [opt] <port1 port2...>    install ports" << endl;
@@ -260,12 +275,6 @@ void PrtGet::printUsage()
 /*! print list of duplicate packages in the repository */
 void PrtGet::listShadowed()
 {
-    if ( m_parser->useCache() ) {
-        cout << m_appName << ": command 'dup' can't work on a cache" << endl;
-        m_returnValue = PG_GENERAL_ERROR;
-        return;
-    }
-
     initRepo( true );
 
     string format = "%p1 %v1 > %p2 %v2\n";
@@ -278,7 +287,7 @@ void PrtGet::listShadowed()
     Package* p1;
     Package* p2;
 
-    list<pair<Package*, Package*> >::const_iterator it =
+    vector< pair<Package*, Package*> >::const_iterator it =
         m_repo->shadowedPackages().begin();
     for ( ; it != m_repo->shadowedPackages().end(); ++it ) {
         output = format;
@@ -313,6 +322,11 @@ void PrtGet::listPackages()
     initRepo();
     list<Package*> packages;
     m_repo->getMatchingPackages( arg, packages );
+    if ( m_parser->verbose() > 0 ) {
+        m_repo->loadPackages( packages, Package::VERSION_FIELDS |
+                              ( m_parser->verbose() > 1 ?
+                                Package::HEADER_FIELDS : 0 ) );
+    }
     if ( packages.size() ) {
         list<Package*>::iterator it = packages.begin();
         for ( ; it != packages.end(); ++it ) {
@@ -348,6 +362,11 @@ void PrtGet::searchPackages( bool searchDesc )
     string arg = *(m_parser->otherArgs().begin());
     list<Package*> packages;
     m_repo->searchMatchingPackages( arg, packages, searchDesc );
+    if ( m_parser->verbose() > 0 ) {
+        m_repo->loadPackages( packages, Package::VERSION_FIELDS |
+                              ( m_parser->verbose() > 1 ?
+                                Package::HEADER_FIELDS : 0 ) );
+    }
     if ( packages.size() ) {
         list<Package*>::iterator it = packages.begin();
         for ( ; it != packages.end(); ++it ) {
@@ -455,28 +474,22 @@ void PrtGet::initRepo( bool listDuplicate )
                 cerr << "Can't open cache file: " << m_cacheFile << endl;
                 m_returnValue = PG_GENERAL_ERROR;
                 return;
-            } else if ( result == Repository::FORMAT_ERR ) {
-                cerr << "warning: your cache file "
-                     << m_cacheFile << " was made with an "
-                     << "older version "
-                     << "of prt-get."
-                     << "\nPlease regenerate it using"
-                     << "\n  prt-get cache" << endl;
-                m_returnValue = PG_GENERAL_ERROR;
-                return;
             }
 
-            struct stat cacheStat;
-            struct stat confStat;
-            stat( m_cacheFile.c_str(), &cacheStat );
-            stat( CONF_FILE.c_str(), &confStat );
-            if ( confStat.st_ctime > cacheStat.st_ctime ) {
-                cerr << "Error: "
-                     << "Configuration changed after generating cache"
-                     << endl;
-                cerr << "regenerate cache using 'prt-get cache'" << endl;
-                m_returnValue = PG_GENERAL_ERROR;
-                return;
+            if ( result == Repository::FORMAT_ERR ||
+                 !m_repo->isCacheCurrent( m_config->rootList() ) ) {
+                m_repo->refresh( m_config->rootList(), false );
+                if ( !cacheWritable() ) {
+                    cerr << "warning: cache file " << m_cacheFile
+                         << " is out of date, run 'prt-get cache' as root"
+                         << " to update it" << endl;
+                } else {
+                    cerr << "warning: cache file " << m_cacheFile
+                         << " is out of date, updating it" << endl;
+                    if ( !writeCache() ) {
+                        m_returnValue = PG_GENERAL_ERROR;
+                    }
+                }
             }
 
             if ( !m_parser->wasCalledAsPrtCached() ) {
@@ -489,6 +502,27 @@ void PrtGet::initRepo( bool listDuplicate )
     }
 }
 
+/*!
+  load the ports of all installed packages at once, which is a lot
+  faster than loading them one by one
+  \param fields the Package::FieldGroups required
+  \sa Repository::loadPackages()
+ */
+void PrtGet::loadInstalledPorts( unsigned int fields )
+{
+    list<const Package*> ports;
+    const map<string, string>& installed = m_pkgDB->installedPackages();
+    map<string, string>::const_iterator it = installed.begin();
+    for ( ; it != installed.end(); ++it ) {
+        const Package* p = m_repo->getPackage( it->first );
+        if ( p ) {
+            ports.push_back( p );
+        }
+    }
+
+    m_repo->loadPackages( ports, fields );
+}
+
 /*! print whether a package is installed or not */
 void PrtGet::isInstalled()
 {
@@ -565,11 +599,12 @@ void PrtGet::listInstalled()
         }
 	
     } else {
+	if ( m_parser->verbose() > 1 ) {
+	    // warning: will slow down the process...
+	    initRepo();
+	    loadInstalledPorts( Package::HEADER_FIELDS );
+	}
 	for ( ; it != l.end(); ++it ) {
-	    if ( m_parser->verbose() > 1 ) {
-		// warning: will slow down the process...
-		initRepo();
-	    }
 	    cout <<  it->first.c_str();
 	    if ( m_parser->verbose() > 0 ) {
 		cout << " " << it->second.c_str();
@@ -628,6 +663,7 @@ void PrtGet::install( bool update, bool group, bool dependencies )
         // TODO: code duplication with printDepends!
         if ( result == InstallTransaction::CYCLIC_DEPEND ) {
             cerr << "prt-get: cyclic dependencies found" << endl;
+            warnCyclicDependencies(depTransaction);
             m_returnValue = PG_GENERAL_ERROR;
             return;
         } else if ( result == InstallTransaction::PACKAGE_NOT_FOUND ) {
@@ -693,6 +729,9 @@ void PrtGet::executeTransaction( InstallTransaction& transaction,
         failed = true;
     } else if ( result == InstallTransaction::PKGADD_FAILURE ) {
         cout << m_appName << ": error while pkgadding " << endl;
+    } else if ( result == InstallTransaction::FILE_CONFLICT ) {
+        cout << m_appName << ": file conflicts, not " << command[1]
+             << endl;
     } else if ( result == InstallTransaction::LOG_DIR_FAILURE ) {
         cout << m_appName << ": can't create log file directory " << endl;
     } else if ( result == InstallTransaction::LOG_FILE_FAILURE ) {
@@ -742,6 +781,7 @@ void PrtGet::printDepends( bool simpleListing )
     InstallTransaction::InstallResult result = transaction.calcDependencies();
     if ( result == InstallTransaction::CYCLIC_DEPEND ) {
         cerr << "prt-get: cyclic dependencies found" << endl;
+        warnCyclicDependencies(transaction);
         m_returnValue = PG_GENERAL_ERROR;
         return;
     } else if ( result == InstallTransaction::PACKAGE_NOT_FOUND ) {
@@ -833,6 +873,8 @@ void PrtGet::readConfig()
                             it->second == ArgParser::CONFIG_SET,
                             it->second == ArgParser::CONFIG_PREPEND);
     }
+
+    ShellEvaluator::setEnabled( m_config->evalVersions() );
 }
 
 /*!
@@ -842,6 +884,7 @@ void PrtGet::readConfig()
 void PrtGet::printQuickDiff()
 {
     initRepo();
+    loadInstalledPorts( Package::VERSION_FIELDS );
 
     const map<string, string>& installed = m_pkgDB->installedPackages();
     map<string, string>::const_iterator it = installed.begin();
@@ -893,6 +936,7 @@ void PrtGet::printFormattedDiffLine(const string& name,
 void PrtGet::printDiff()
 {
     initRepo();
+    loadInstalledPorts( Package::VERSION_FIELDS );
     map< string, string > l;
     if ( m_parser->otherArgs().size() > 0 ) {
         expandWildcardsPkgDB( m_parser->otherArgs(), l );
@@ -1061,6 +1105,18 @@ void PrtGet::evaluateResult( InstallTransaction& transaction,
         }
     }
 
+    const list< pair<string, string> >& conflicts =
+        transaction.fileConflicts();
+    if ( conflicts.size() ) {
+        ++errors;
+        cout << endl << "-- Packages with files owned by other packages "
+             << "(use -f to " << command[0] << " them anyway)" << endl;
+        list< pair<string, string> >::const_iterator cit = conflicts.begin();
+        for ( ; cit != conflicts.end(); ++cit ) {
+            cout << cit->first << ": " << cit->second << endl;
+        }
+    }
+
     const list<string>& already = transaction.alreadyInstalledPackages();
     if ( already.size() ) {
         cout << endl << "-- Packages installed before this run (ignored)"
@@ -1182,24 +1238,159 @@ void PrtGet::createCache()
         return;
     }
 
-    initRepo();
     if (m_config->cacheFile() != "") {
         m_cacheFile = m_config->cacheFile();
     }
 
+    list<string> changedPorts;
+    const string& updateFrom = m_parser->updateFrom();
+    if ( updateFrom != "" &&
+         !readPortList( updateFrom, changedPorts ) ) {
+        cerr << "Can't read list of changed ports: " << updateFrom << endl;
+        m_returnValue = PG_GENERAL_ERROR;
+        return;
+    }
+
+    m_repo = new Repository(m_useRegex);
+    Repository::CacheReadResult result = Repository::ACCESS_ERR;
+    if ( !m_parser->isForced() ) {
+        // reuse what's still valid; a broken cache is simply replaced
+        result = m_repo->initFromCache( m_cacheFile );
+    }
+
+    size_t changed;
+    if ( updateFrom != "" && result == Repository::READ_OK ) {
+        list<string> unknownPorts;
+        changed = m_repo->refresh( m_config->rootList(), false,
+                                   &changedPorts, &unknownPorts );
+        if ( !unknownPorts.empty() ) {
+            list<string>::const_iterator it = unknownPorts.begin();
+            for ( ; it != unknownPorts.end(); ++it ) {
+                cerr << "Not in any ports directory: " << *it << endl;
+            }
+            cerr << m_appName << ": cache not updated" << endl;
+            m_returnValue = PG_GENERAL_ERROR;
+            return;
+        }
+    } else {
+        changed = m_repo->refresh( m_config->rootList(), true );
+    }
+    if ( m_parser->verbose() > 0 ) {
+        cout << "Reading " << changed << " of "
+             << m_repo->packages().size() << " ports" << endl;
+    }
+
+    if ( !writeCache() ) {
+        m_returnValue = PG_GENERAL_ERROR;
+        return;
+    }
+
+    // only speeds up fsearch, which reads the footprints without it
+    if ( !writeFootprintIndex( updateFrom != "" &&
+                               result == Repository::READ_OK ) ) {
+        cerr << "warning: footprint index not updated" << endl;
+    }
+}
+
+/*!
+  read a list of port directories, one per line
+  \param fileName the file to read; "-" for stdin
+  \param ports the list of port directories
+  \return false if \a fileName could not be read
+ */
+bool PrtGet::readPortList( const string& fileName, list<string>& ports )
+{
+    FILE* fp = stdin;
+    if ( fileName != "-" ) {
+        fp = fopen( fileName.c_str(), "r" );
+        if ( !fp ) {
+            return false;
+        }
+    }
+
+    const int length = BUFSIZ;
+    char input[length];
+    while ( fgets( input, length, fp ) ) {
+        string line = StringHelper::stripWhiteSpace( input );
+        if ( !line.empty() && line[0] != '#' ) {
+            ports.push_back( line );
+        }
+    }
+
+    if ( fp != stdin ) {
+        fclose( fp );
+    }
+    return true;
+}
+
+/*!
+  \return whether writeCache() can replace the cache file; it is written
+  to a temporary file next to it and renamed, so this depends on the
+  cache directory only
+ */
+bool PrtGet::cacheWritable() const
+{
+    string dir = ".";
+    string::size_type pos = m_cacheFile.rfind( '/' );
+    if ( pos != string::npos ) {
+        dir = pos == 0 ? "/" : m_cacheFile.substr( 0, pos );
+    }
+    return access( dir.c_str(), W_OK ) == 0;
+}
+
+/*!
+  write the repository to the cache file
+  \return whether the cache could be written
+ */
+bool PrtGet::writeCache()
+{
     Repository::WriteResult result = m_repo->writeCache( m_cacheFile );
     if ( result == Repository::DIR_ERR ) {
         cerr << "Can't create cache directory " << m_cacheFile << endl;
-        m_returnValue = PG_GENERAL_ERROR;
-        return;
+        return false;
     }
     if ( result == Repository::FILE_ERR ) {
         cerr << "Can't open cache file " << m_cacheFile << " for writing"
              << endl;
-        m_returnValue = PG_GENERAL_ERROR;
-        return;
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+  write the footprint index of all ports, next to the cache file
+  \param changedOnly if true, only the footprints of the ports read from
+  their Pkgfile are checked, the others are trusted to be unchanged
+  \sa FootprintIndex
+*/
+bool PrtGet::writeFootprintIndex( bool changedOnly )
+{
+    vector<string> portDirs;
+    set<string> changedDirs;
+    const vector<Package*>& packages = m_repo->packages();
+    vector<Package*>::const_iterator it = packages.begin();
+    for ( ; it != packages.end(); ++it ) {
+        portDirs.push_back( (*it)->path() + "/" + (*it)->name() );
+        if ( !(*it)->cacheFile() ) {
+            changedDirs.insert( portDirs.back() );
+        }
     }
 
+    string::size_type pos = m_cacheFile.rfind( '/' );
+    if ( pos != string::npos &&
+         !Repository::createOutputDir( m_cacheFile.substr( 0, pos ) ) ) {
+        cerr << "Can't create cache directory " << m_cacheFile << endl;
+        return false;
+    }
+
+    string fileName = FootprintIndex::fileName( m_cacheFile );
+    if ( !FootprintIndex::write( fileName, portDirs,
+                                 changedOnly ? &changedDirs : 0 ) ) {
+        cerr << "Can't write footprint index " << fileName << endl;
+        return false;
+    }
+    return true;
 }
 
 /*!
@@ -1244,6 +1435,7 @@ void PrtGet::printf()
     }
     list<Package*> packages;
     m_repo->getMatchingPackages( filter, packages );
+    m_repo->loadPackages( packages );
     list<Package*>::const_iterator it = packages.begin();
 
     const string formatString = *(m_parser->otherArgs().begin());
@@ -1368,36 +1560,77 @@ void PrtGet::printDependent()
     initRepo();
     string arg = *(m_parser->otherArgs().begin());
 
+    // only the dependencies are needed for the index; versions and
+    // descriptions only if they're printed
+    const vector<Package*>& all = m_repo->packages();
+    list<Package*> packages( all.begin(), all.end() );
+    unsigned int fields = Package::DEPENDS_FIELD;
+    if ( m_parser->verbose() > 0 ) {
+        fields |= Package::VERSION_FIELDS;
+    }
+    if ( m_parser->verbose() > 1 ) {
+        fields |= Package::HEADER_FIELDS;
+    }
+    m_repo->loadPackages( packages, fields );
+
+    DependentIndex index;
+    buildDependentIndex(index);
+    set<string> visited;
+
     if (m_parser->printTree()) {
         cout << arg << endl;
-        printDependent(arg, 2);
+        visited.insert(arg);
+        printDependent(arg, 2, index, visited);
     } else {
-        printDependent(arg, 0);
+        printDependent(arg, 0, index, visited);
     }
 }
 
-void PrtGet::printDependent(const string& dep, int level)
+/*!
+  index the packages of the repository by their dependencies, so the
+  dependencies are read only once, rather than once per printed package
+*/
+void PrtGet::buildDependentIndex(DependentIndex& index)
 {
-    map<string, Package*>::const_iterator it = m_repo->packages().begin();
-    static map<string, bool> shownMap;
-
-    set<const Package*> dependent;
+    vector<Package*>::const_iterator it = m_repo->packages().begin();
     for ( ; it != m_repo->packages().end(); ++it ) {
+        const Package* p = *it;
+        if ( !p || p->dependencies().empty() ) {
+            continue;
+        }
 
-        // TODO: is the following line needed?
-        const Package* p = it->second;
-        if ( p && p->dependencies().find( dep ) != string::npos ) {
-            list<string> tokens;
-            StringHelper::split( p->dependencies(), ',', tokens );
-            list<string>::iterator it = find( tokens.begin(),
-                                              tokens.end(),
-                                              dep );
-            if ( it != tokens.end() ) {
-                dependent.insert( p );
+        vector<string> tokens;
+        StringHelper::split( p->dependencies(), ',', tokens );
+        vector<string>::iterator tit = tokens.begin();
+        for ( ; tit != tokens.end(); ++tit ) {
+            vector<const Package*>& dependent = index[*tit];
+            if ( dependent.empty() || dependent.back() != p ) {
+                dependent.push_back( p );
             }
         }
     }
 
+    DependentIndex::iterator iit = index.begin();
+    for ( ; iit != index.end(); ++iit ) {
+        sort( iit->second.begin(), iit->second.end(), lessByName );
+    }
+}
+
+/*!
+  print the packages depending on \a dep
+  \param visited in tree mode, the packages on the path to \a dep, which
+  aren't descended into again; in recursive mode the packages shown
+  already
+*/
+void PrtGet::printDependent(const string& dep, int level,
+                            const DependentIndex& index, set<string>& visited)
+{
+    DependentIndex::const_iterator found = index.find( dep );
+    if ( found == index.end() ) {
+        return;
+    }
+    const vector<const Package*>& dependent = found->second;
+
     // - there are two modes, tree and non-tree recursive mode; in
     // tree mode, packages are shown multiple times, in non tree
     // recursive mode they're only printed the first time; this is not
@@ -1414,15 +1647,14 @@ void PrtGet::printDependent(const string& dep, int level)
             indent += " ";
         }
     }
-    set<const Package*>::iterator it2 = dependent.begin();
-    for ( ; it2 != dependent.end(); ++it2 ) {
-        const Package* p = *it2;
+    vector<const Package*>::const_iterator it = dependent.begin();
+    for ( ; it != dependent.end(); ++it ) {
+        const Package* p = *it;
 
         if (m_parser->recursive() && !m_parser->printTree()) {
-            if (shownMap[p->name()]) {
+            if (!visited.insert(p->name()).second) {
                 continue;
             }
-            shownMap[p->name()] = true;
         }
 
         if ( m_parser->all() || m_pkgDB->isInstalled( p->name() ) ) {
@@ -1437,8 +1669,15 @@ void PrtGet::printDependent(const string& dep, int level)
 
             cout << endl;
 
-            if (m_parser->recursive()) {
-                printDependent( p->name(), level+2 );
+            if (!m_parser->recursive()) {
+                continue;
+            }
+            if (!m_parser->printTree()) {
+                printDependent( p->name(), level+2, index, visited );
+            } else if (visited.insert(p->name()).second) {
+                // a cycle otherwise
+                printDependent( p->name(), level+2, index, visited );
+                visited.erase(p->name());
             }
         }
     }
@@ -1447,6 +1686,9 @@ void PrtGet::printDependent(const string& dep, int level)
 void PrtGet::listOrphans()
 {
     initRepo();
+    loadInstalledPorts( Package::DEPENDS_FIELD |
+                        ( m_parser->verbose() > 1 ?
+                          Package::HEADER_FIELDS : 0 ) );
     map<string, string> installed = m_pkgDB->installedPackages();
     map<string, bool> required;
     map<string, string>::iterator it = installed.begin();
@@ -1493,10 +1735,28 @@ void PrtGet::warnPackageNotFound(InstallTransaction& transaction)
     cerr << "' could not be found: " << endl;
 }
 
+/*!
+  print the ports depending on each other, one cycle per line
+*/
+void PrtGet::warnCyclicDependencies(InstallTransaction& transaction)
+{
+    const list< list<string> >& cycles = transaction.cyclicDependencies();
+    list< list<string> >::const_iterator it = cycles.begin();
+    for ( ; it != cycles.end(); ++it ) {
+        cerr << "Ports depending on each other:";
+        list<string>::const_iterator nit = it->begin();
+        for ( ; nit != it->end(); ++nit ) {
+            cerr << " " << *nit;
+        }
+        cerr << endl;
+    }
+}
+
 void PrtGet::sysup()
 {
     // TODO: refactor getDifferentPackages from diff/quickdiff
     initRepo();
+    loadInstalledPorts( Package::VERSION_FIELDS );
 
     list<string>* target;
     list<string> packagesToUpdate;
@@ -1537,6 +1797,7 @@ void PrtGet::sysup()
         InstallTransaction::InstallResult result = depTrans.calcDependencies();
         if ( result == InstallTransaction::CYCLIC_DEPEND ) {
             cerr << "cyclic dependencies" << endl;
+            warnCyclicDependencies(depTrans);
             m_returnValue = PG_GENERAL_ERROR;
             return;
         } else if ( result == InstallTransaction::PACKAGE_NOT_FOUND ) {
@@ -1599,21 +1860,46 @@ void PrtGet::current()
 {
     assertExactArgCount(1);
 
-    const map<string, string>& installed = m_pkgDB->installedPackages();
-    map<string, string>::const_iterator it = installed.begin();
     string search = *(m_parser->otherArgs().begin());
-
-    for ( ; it != installed.end(); ++it ) {
-        if ( it->first == search ) {
-            cout << it->second.c_str() << endl;
-            return;
-        }
+    if ( m_pkgDB->isInstalled( search, false ) ) {
+        cout << m_pkgDB->getPackageVersion( search ).c_str() << endl;
+        return;
     }
 
     cout << "Package " << search << " not installed" << endl;
     m_returnValue = 1;
 }
 
+/*!
+  print the installed packages owning the files given as arguments
+*/
+void PrtGet::owner()
+{
+    assertMinArgCount(1);
+
+    const list<char*>& args = m_parser->otherArgs();
+    list<char*>::const_iterator it = args.begin();
+    for ( ; it != args.end(); ++it ) {
+        vector<string> owners;
+        if ( !m_pkgDB->findOwners( *it, owners ) ) {
+            cerr << m_appName << ": can't read package database" << endl;
+            m_returnValue = PG_GENERAL_ERROR;
+            return;
+        }
+
+        if ( owners.empty() ) {
+            cout << *it << " is not owned by any package" << endl;
+            m_returnValue = 1;
+            continue;
+        }
+        cout << *it << ":";
+        for ( size_t i = 0; i < owners.size(); ++i ) {
+            cout << " " << owners[i];
+        }
+        cout << endl;
+    }
+}
+
 SignalHandler::HandlerResult PrtGet::handleSignal( int signal )
 {
     // TODO: second argument could also be true:
@@ -1640,30 +1926,64 @@ void PrtGet::fsearch()
     }
 
     initRepo();
-    const map<string, Package*>& packages = m_repo->packages();
-    map<string, Package*>::const_iterator it = packages.begin();
+
+    // the footprint index is only used with the cache; ports changed
+    // since it was written are still searched in their footprint
+    FootprintIndex index;
+    bool useIndex = false;
+    if ( m_parser->useCache() || m_parser->reindex() ) {
+        if ( m_config->cacheFile() != "" ) {
+            m_cacheFile = m_config->cacheFile();
+        }
+        if ( m_parser->reindex() && !writeFootprintIndex() ) {
+            m_returnValue = PG_GENERAL_ERROR;
+        }
+        useIndex = index.open( FootprintIndex::fileName( m_cacheFile ) );
+        if ( useIndex ) {
+            index.setPattern( arg, m_parser->fullPath(), m_useRegex );
+        }
+    }
+
+    // footprints not covered by the index are searched in parallel;
+    // the results are printed in the order of the ports
+    const vector<Package*>& packages = m_repo->packages();
+    vector< list<string> > matches( packages.size() );
+    vector<char> found( packages.size(), 0 );
+    vector<string> footprints;
+    vector<size_t> grepped;
+    for ( size_t i = 0; i < packages.size(); ++i ) {
+        string dir = packages[i]->path() + "/" + packages[i]->name();
+        if ( useIndex && index.grep( dir, matches[i] ) ) {
+            found[i] = 1;
+        } else {
+            footprints.push_back( dir + "/" + ".footprint" );
+            grepped.push_back( i );
+        }
+    }
+
+    vector< list<string> > grepMatches;
+    vector<char> grepFound;
+    File::grep( footprints, arg, grepMatches, grepFound,
+                m_parser->fullPath(), m_useRegex );
+    for ( size_t i = 0; i < grepped.size(); ++i ) {
+        matches[grepped[i]].swap( grepMatches[i] );
+        found[grepped[i]] = grepFound[i];
+    }
+
     bool first = true;
-    for ( ; it != packages.end(); ++it ) {
-        list<string> matches;
-        string fp =
-            it->second->path() + "/" +
-            it->second->name() + "/" + ".footprint";
-        if ( File::grep( fp, arg, matches,
-                         m_parser->fullPath(),
-                         m_useRegex)) {
-            if ( matches.size() > 0 ) {
-                if ( first ) {
-                    first = false;
-                } else {
-                    cout << endl;
-                }
-                cout << "Found in "
-                     << it->second->path() << "/"
-                     << it->first << ":" << endl;
-                list<string>::iterator it = matches.begin();
-                for ( ; it != matches.end(); ++it ) {
-                    cout << "  " << *it << endl;
-                }
+    for ( size_t i = 0; i < packages.size(); ++i ) {
+        if ( found[i] && matches[i].size() > 0 ) {
+            if ( first ) {
+                first = false;
+            } else {
+                cout << endl;
+            }
+            cout << "Found in "
+                 << packages[i]->path() << "/"
+                 << packages[i]->name() << ":" << endl;
+            list<string>::iterator it = matches[i].begin();
+            for ( ; it != matches[i].end(); ++it ) {
+                cout << "  " << *it << endl;
             }
         }
     }
@@ -2104,6 +2424,12 @@ void PrtGet::dumpConfig()
     cout << "Keep higher version:" <<(m_config->preferHigher() ? "yes" : "no" )
          << endl;
 
+    cout.setf( ios::left, ios::adjustfield );
+    cout.width( 20 );
+    cout.fill( ' ' );
+    cout << "Evaluate versions: " <<(m_config->evalVersions() ? "yes" : "no" )
+         << endl;
+
     cout.setf( ios::left, ios::adjustfield );
     cout.width( 20 );
     cout.fill( ' ' );
@@ -17,7 +17,10 @@ class ArgParser;
 class Configuration;
 
 #include <list>
+#include <set>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 #include <string>
 using namespace std;
 
@@ -66,6 +69,7 @@ public:
                   bool dependencies=false );
     void sysup();
     void current();
+    void owner();
     void printDepends( bool simpleListing=false );
     void printDependTree();
     void printDependent();
@@ -99,7 +103,11 @@ protected:
 
     void printDepsLevel(int indent, const Package* package);
 
-    void printDependent(const std::string& dep, int level);
+    // dependency -> packages depending on it, sorted by name
+    typedef unordered_map<string, vector<const Package*> > DependentIndex;
+    void buildDependentIndex(DependentIndex& index);
+    void printDependent(const std::string& dep, int level,
+                        const DependentIndex& index, set<string>& visited);
 
     void executeTransaction( InstallTransaction& transaction,
                              bool update, bool group );
@@ -110,6 +118,11 @@ protected:
 
     void readConfig();
     void initRepo( bool listDuplicate=false );
+    bool writeCache();
+    bool cacheWritable() const;
+    bool writeFootprintIndex( bool changedOnly=false );
+    static bool readPortList( const string& fileName, list<string>& ports );
+    void loadInstalledPorts( unsigned int fields );
 
     void expandWildcardsPkgDB( const list<char*>& in,
                                map<string, string>& target );
@@ -117,6 +130,7 @@ protected:
                               list<string>& target );
 
     void warnPackageNotFound(InstallTransaction& transaction);
+    void warnCyclicDependencies(InstallTransaction& transaction);
 
     static void printFormattedDiffLine(const string& name,
                                        const string& version1,
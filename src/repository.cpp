@@ -10,10 +10,12 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <set>
 using namespace std;
 
 
@@ -21,22 +23,55 @@ using namespace std;
 #include <sys/stat.h>
 #include <dirent.h>
 #include <unistd.h>
-#include <fnmatch.h>
 
+#include "cachefile.h"
 #include "datafileparser.h"
 #include "repository.h"
 #include "stringhelper.h"
 #include "pg_regex.h"
+#include "pkgfilereader.h"
+#include "portscanner.h"
+#include "shellevaluator.h"
+#include "trigramindex.h"
+#include "workerpool.h"
 using namespace StringHelper;
 
+namespace
+{
+    // fewer Pkgfiles are simply read by the worker threads
+    const size_t MIN_BATCH_READ = 32;
+
+    PortFingerprint fingerprintFromRow( const uint32_t* row )
+    {
+        PortFingerprint fingerprint;
+        fingerprint.dirTime = row[0];
+        fingerprint.dirTimeNsec = row[1];
+        fingerprint.pkgfileTime = row[2];
+        fingerprint.pkgfileTimeNsec = row[3];
+        fingerprint.pkgfileSize = row[4];
+        return fingerprint;
+    }
+
+    void appendFingerprint( vector<uint32_t>& rows,
+                            const PortFingerprint& fingerprint )
+    {
+        rows.push_back( fingerprint.dirTime );
+        rows.push_back( fingerprint.dirTimeNsec );
+        rows.push_back( fingerprint.pkgfileTime );
+        rows.push_back( fingerprint.pkgfileTimeNsec );
+        rows.push_back( fingerprint.pkgfileSize );
+    }
+}
 
-const string Repository::CACHE_VERSION = "V5";
 
 /*!
   Create a repository
 */
 Repository::Repository(bool useRegex)
-    : m_useRegex(useRegex)
+    : m_useRegex(useRegex),
+      m_shadowedRead(true),
+      m_cache(0),
+      m_allFromCache(false)
 {
 }
 
@@ -45,19 +80,56 @@ Repository::Repository(bool useRegex)
 */
 Repository::~Repository()
 {
-    map<string, Package*>::const_iterator it = m_packageMap.begin();
-    for ( ; it != m_packageMap.end(); ++it ) {
-        delete it->second;
-    }
+    clear();
+    delete m_cache;
+}
+
+/*!
+  remove all packages from the repository
+*/
+void Repository::clear()
+{
+    m_arena.clear();
+    m_packages.clear();
+    m_shadowedPackages.clear();
+    m_shadowedRead = true;
+
+    m_portsDirs.clear();
+}
+
+Repository::CachedPort::CachedPort()
+    : hasRecord( false ),
+      cacheIndex( 0 ),
+      version( "" ),
+      release( "" )
+{
 }
 
 
 /*!
-  \return a map of available packages
+  \return the available packages, sorted by name
 */
-const map<string, Package*>& Repository::packages() const
+const vector<Package*>& Repository::packages() const
 {
-    return m_packageMap;
+    if ( m_cache && !m_allFromCache ) {
+        m_allFromCache = true;
+
+        // the cache is sorted by name already; only duplicates, which
+        // a broken cache might contain, have to be dropped
+        size_t used = 0;
+        for ( size_t i = 0; i < m_packages.size(); ++i ) {
+            Package* p = m_packages[i];
+            if ( !p ) {
+                p = new ( m_arena.allocate() ) Package( m_cache, i );
+            }
+            if ( used == 0 || m_packages[used-1]->name() != p->name() ) {
+                m_packages[used++] = p;
+            }
+        }
+        m_packages.resize( used );
+    }
+
+    return m_packages;
 }
 
 
@@ -67,11 +139,44 @@ const map<string, Package*>& Repository::packages() const
   \a second is the port which preceeds over \a first
   \return a list of duplicate packages in the repository
 */
-const list< pair<Package*, Package*> >& Repository::shadowedPackages() const
+const vector< pair<Package*, Package*> >& Repository::shadowedPackages() const
 {
+    if ( !m_shadowedRead ) {
+        m_shadowedRead = true;
+
+        uint32_t rows = 0;
+        const uint32_t* row =
+            m_cache->table( CacheFile::SHADOWED,
+                            CacheFile::SHADOWED_ROW, rows );
+        m_shadowedPackages.reserve( rows );
+        for ( uint32_t i = 0; i < rows; ++i, row += CacheFile::SHADOWED_ROW ) {
+            Package* winner = findPackage( m_cache->stringAt( row[0] ) );
+            if ( winner ) {
+                m_shadowedPackages.push_back(
+                    make_pair( newShadowedPackage( row ), winner ) );
+            }
+        }
+    }
+
     return m_shadowedPackages;
 }
 
+/*!
+  \return a package for \a row of the SHADOWED table; only its name,
+  path and version are known
+*/
+Package* Repository::newShadowedPackage( const uint32_t* row ) const
+{
+    Package* p =
+        new ( m_arena.allocate() ) Package( m_cache->stringAt( row[0] ),
+                                            m_cache->stringAt( row[1] ),
+                                            m_cache->stringAt( row[2] ),
+                                            m_cache->stringAt( row[3] ),
+                                            "", "", "", "", "", "", "", "" );
+    p->setFingerprint( fingerprintFromRow( row + 4 ) );
+    return p;
+}
+
 
 /*!
   \param name the package name to be returned
@@ -79,11 +184,35 @@ const list< pair<Package*, Package*> >& Repository::shadowedPackages() const
 */
 const Package* Repository::getPackage( const string& name ) const
 {
-    map<string, Package*>::const_iterator it = m_packageMap.find( name );
-    if ( it == m_packageMap.end() ) {
-        return 0;
+    return findPackage( name );
+}
+
+/*!
+  look up a package, creating it from the cache if required
+  \return a Package pointer for a package name or 0 if not found
+*/
+Package* Repository::findPackage( const string& name ) const
+{
+    if ( m_cache && !m_allFromCache ) {
+        size_t index;
+        if ( !m_cache->findPackage( name.c_str(), index ) ) {
+            return 0;
+        }
+        if ( !m_packages[index] ) {
+            m_packages[index] =
+                new ( m_arena.allocate() ) Package( m_cache, index );
+        }
+        return m_packages[index];
+    }
+
+    vector<Package*>::const_iterator it =
+        lower_bound( m_packages.begin(), m_packages.end(),
+                     name, comparePackageName );
+    if ( it != m_packages.end() && (*it)->name() == name ) {
+        return *it;
     }
-    return it->second;
+
+    return 0;
 }
 
 
@@ -101,38 +230,178 @@ const Package* Repository::getPackage( const string& name ) const
 void Repository::searchMatchingPackages( const string& pattern,
                                          list<Package*>& target,
                                          bool searchDesc ) const
-    // note: searchDesc true will read _every_ Pkgfile
+    // note: searchDesc true will read _every_ Pkgfile, unless a cache
+    // with a trigram index is used
 {
-    map<string, Package*>::const_iterator it = m_packageMap.begin();
+    const vector<Package*>& all = packages();
+
+    // packages read from the cache are only checked if the index of
+    // the cache says they might match
+    vector<uint32_t> candidates;
+    bool useIndex = false;
+    if ( m_cache ) {
+        TrigramIndex index( m_cache, m_cache->packageCount() );
+        useIndex = index.candidates( pattern, m_useRegex, candidates );
+    }
+
+    vector<Package*> toCheck;
+    vector<Package*>::const_iterator it = all.begin();
+    for ( ; it != all.end(); ++it ) {
+        if ( !useIndex || (*it)->cacheFile() != m_cache ||
+             binary_search( candidates.begin(), candidates.end(),
+                            (*it)->cacheIndex() ) ) {
+            toCheck.push_back( *it );
+        }
+    }
+
+    if ( searchDesc ) {
+        vector<const Package*> toLoad( toCheck.begin(), toCheck.end() );
+        loadPackages( toLoad, Package::HEADER_FIELDS );
+    }
+
+    it = toCheck.begin();
     if (m_useRegex) {
         RegEx re(pattern);
-        for ( ; it != m_packageMap.end(); ++it ) {
-            if (re.match(it->first)) {
-                target.push_back( it->second );
+        for ( ; it != toCheck.end(); ++it ) {
+            if (re.match((*it)->name())) {
+                target.push_back( *it );
             } else if ( searchDesc ) {
-                if ( re.match(it->second->description())) {
-                    target.push_back( it->second );
+                if ( re.match((*it)->description())) {
+                    target.push_back( *it );
                 }
             }
         }
     } else {
-        for ( ; it != m_packageMap.end(); ++it ) {
-            if ( it->first.find( pattern ) != string::npos ) {
-                target.push_back( it->second );
-            } else if (searchDesc ) {
-                string s = toLowerCase( it->second->description() );
-                if ( s.find( toLowerCase( pattern ) ) != string::npos ) {
-                    target.push_back( it->second );
-                }
+        for ( ; it != toCheck.end(); ++it ) {
+            if ( (*it)->name().find( pattern ) != string::npos ) {
+                target.push_back( *it );
+            } else if ( searchDesc &&
+                        containsNoCase( (*it)->description(), pattern ) ) {
+                target.push_back( *it );
             }
         }
     }
 }
 
-int Repository::compareShadowPair(pair<Package*, Package*>& p1,
-                                  pair<Package*, Package*>& p2)
+/*!
+  Load the Pkgfiles of all packages in the repository, using multiple
+  threads. Calling this is never required, but much faster than the
+  lazy initialization of each package when most of them are needed
+  anyway.
+*/
+void Repository::loadPackages() const
 {
-    return p1.second->name() < p2.second->name();
+    const vector<Package*>& all = Repository::packages();
+    vector<const Package*> packages( all.begin(), all.end() );
+    loadPackages( packages, Package::ALL_FIELDS );
+}
+
+/*!
+  Load the Pkgfiles of \a packages using multiple threads
+  \param packages the packages to load
+  \param fields the Package::FieldGroups required
+  \sa loadPackages()
+*/
+void Repository::loadPackages( const list<Package*>& packages,
+                               unsigned int fields ) const
+{
+    vector<const Package*> toLoad( packages.begin(), packages.end() );
+    loadPackages( toLoad, fields );
+}
+
+/*!
+  Load the Pkgfiles of \a packages using multiple threads
+  \param packages the packages to load
+  \param fields the Package::FieldGroups required
+  \sa loadPackages()
+*/
+void Repository::loadPackages( const list<const Package*>& packages,
+                               unsigned int fields ) const
+{
+    vector<const Package*> toLoad( packages.begin(), packages.end() );
+    loadPackages( toLoad, fields );
+}
+
+/*!
+  Load \a fields of \a packages; if there are enough Pkgfiles to be
+  read, the files are read in one batch by PkgfileReader first, and
+  only parsed by the worker threads
+*/
+void Repository::loadPackages( const vector<const Package*>& packages,
+                               unsigned int fields )
+{
+    LoadJob job;
+    job.fields = fields;
+    for ( size_t i = 0; i < packages.size(); ++i ) {
+        if ( packages[i]->needsPkgfile( fields ) ) {
+            job.packages.push_back( packages[i] );
+        } else {
+            job.others.push_back( packages[i] );
+        }
+    }
+
+    if ( job.packages.size() < MIN_BATCH_READ ||
+         !PkgfileReader::readAll( job.packages, job.files,
+                                  ( fields & Package::FILE_FLAGS ) != 0 ) ) {
+        job.files.clear();
+    }
+    job.packages.insert( job.packages.end(),
+                         job.others.begin(), job.others.end() );
+
+    WorkerPool::run( job.packages.size(), loadPackageJob, &job );
+
+    if ( fields & Package::VERSION_FIELDS ) {
+        evaluateVersions( job.packages );
+    }
+}
+
+void Repository::loadPackageJob( size_t index, void* data )
+{
+    const LoadJob* job = static_cast<const LoadJob*>( data );
+    if ( index < job->files.size() && job->files[index].valid ) {
+        const PortFiles& files = job->files[index];
+        job->packages[index]->load( files.pkgfile, job->fields,
+                                    files.hasReadme,
+                                    files.hasPreInstall,
+                                    files.hasPostInstall );
+    } else {
+        job->packages[index]->load( job->fields );
+    }
+}
+
+/*!
+  evaluate the versions of those \a packages which require a shell in
+  one batch, rather than one after another when they're accessed
+*/
+void Repository::evaluateVersions( const vector<const Package*>& packages )
+{
+    vector<const Package*> pending;
+    vector<string> dirs;
+    for ( size_t i = 0; i < packages.size(); ++i ) {
+        if ( packages[i]->needsEvaluation() ) {
+            pending.push_back( packages[i] );
+            dirs.push_back( packages[i]->path() + "/" + packages[i]->name() );
+        }
+    }
+    if ( pending.empty() ) {
+        return;
+    }
+
+    vector<EvaluatedVersion> results;
+    ShellEvaluator::evaluate( dirs, results );
+    for ( size_t i = 0; i < pending.size(); ++i ) {
+        pending[i]->setEvaluatedVersion( results[i] );
+    }
+}
+
+bool Repository::comparePackageName( const Package* p, const string& name )
+{
+    return p->name() < name;
+}
+
+bool Repository::compareFoundPort( const FoundPort& p1, const FoundPort& p2 )
+{
+    return p1.name < p2.name;
 }
 
 
@@ -148,146 +417,505 @@ void Repository::initFromFS( const list< pair<string, string> >& rootList,
                              bool listDuplicate )
 {
     list< pair<string, string> >::const_iterator it = rootList.begin();
-    DIR* d;
-    struct dirent* de;
-    string name;
 
     std::map<string, bool> alreadyChecked;
+    vector<string> paths;
+    vector<FoundPort> found;
 
 
     for ( ; it != rootList.end(); ++it ) {
 
         string path = it->first;
-        string pkgInput = stripWhiteSpace( it->second );
 
         if ( alreadyChecked[path] ) {
             continue;
         }
 
-        bool filter = false;
-        if ( pkgInput.length() > 0 ) {
-            filter = true;
-            // create a proper input string
-            while ( pkgInput.find( " " ) != string::npos ) {
-                pkgInput = pkgInput.replace( pkgInput.find(" "), 1, "," );
-            }
-            while ( pkgInput.find( "\t" ) != string::npos ) {
-                pkgInput = pkgInput.replace( pkgInput.find("\t"), 1, "," );
+        PortFilter filter;
+        filter.parse( it->second );
+
+        if (!filter.isActive()) {
+            alreadyChecked[path] = true;
+        }
+
+
+        PortScanner scanner;
+        if ( !scanner.open( path ) ) {
+            continue;
+        }
+
+        vector<string> entries;
+        scanner.candidates( filter, entries );
+        vector<string>::const_iterator eit = entries.begin();
+        for ( ; eit != entries.end(); ++eit ) {
+            if ( !scanner.isPort( eit->c_str() ) ) {
+                // no Pkgfile -> no port
+                continue;
             }
-            while ( pkgInput.find( ",," ) != string::npos ) {
-                pkgInput = pkgInput.replace( pkgInput.find(",,"), 2, "," );
+
+            FoundPort port;
+            port.name = *eit;
+            port.dir = paths.size();
+            port.port = 0;
+            port.listed = false;
+            found.push_back( port );
+        }
+        paths.push_back( path );
+    }
+
+    // ports of the same name end up next to each other, in the order of
+    // their directories; the first one wins
+    stable_sort( found.begin(), found.end(), compareFoundPort );
+
+    m_packages.reserve( found.size() );
+    Package* winner = 0;
+    vector<FoundPort>::const_iterator fit = found.begin();
+    for ( ; fit != found.end(); ++fit ) {
+        if ( winner && winner->name() == fit->name ) {
+            if ( listDuplicate ) {
+                m_shadowedPackages.push_back(
+                    make_pair( new ( m_arena.allocate() )
+                               Package( fit->name, paths[fit->dir] ),
+                               winner ) );
             }
+        } else {
+            winner = new ( m_arena.allocate() )
+                Package( fit->name, paths[fit->dir] );
+            m_packages.push_back( winner );
         }
+    }
+}
 
-        if (!filter) {
-            alreadyChecked[path] = true;
+/*!
+  Init from a cache file. The file is mapped into memory, packages are
+  created when they're accessed
+  \param cacheFile the name of the cache file to be parser
+  \return true on success, false indicates file opening problems
+*/
+Repository::CacheReadResult
+Repository::initFromCache( const string& cacheFile )
+{
+    CacheFile* cache = new CacheFile;
+    CacheFile::OpenResult result = cache->open( cacheFile );
+    if ( result != CacheFile::OPEN_OK ) {
+        delete cache;
+        return result == CacheFile::ACCESS_ERR ? ACCESS_ERR : FORMAT_ERR;
+    }
+
+    clear();
+    delete m_cache;
+    m_cache = cache;
+    m_packages.assign( m_cache->packageCount(), 0 );
+    m_allFromCache = false;
+    m_shadowedRead = false;
+
+    return READ_OK;
+}
+
+/*!
+  Check whether the cache opened by initFromCache() was written for
+  \a rootList and whether ports were added to or removed from any of
+  the ports directories since. This doesn't check the ports themselves,
+  so it's cheap enough to be done each time the cache is used.
+  \return true if the cache can be used as is
+*/
+bool Repository::isCacheCurrent( const list< pair<string, string> >& rootList ) const
+{
+    if ( !m_cache ) {
+        return false;
+    }
+
+    uint32_t rows = 0;
+    const uint32_t* row =
+        m_cache->table( CacheFile::ROOTS, CacheFile::ROOT_ROW, rows );
+    if ( !row || rows != rootList.size() ) {
+        return false;
+    }
+
+    uint32_t shadowedRows;
+    if ( !m_cache->table( CacheFile::SHADOWED,
+                          CacheFile::SHADOWED_ROW, shadowedRows ) ) {
+        return false;
+    }
+
+    // versions in the cache are evaluated or not
+    if ( cacheEvaluatedVersions() != ShellEvaluator::isEnabled() ) {
+        return false;
+    }
+
+    list< pair<string, string> >::const_iterator it = rootList.begin();
+    for ( ; it != rootList.end(); ++it, row += CacheFile::ROOT_ROW ) {
+        PortsDir dir;
+        readDirTime( it->first, dir );
+        if ( it->first != m_cache->stringAt( row[0] ) ||
+             it->second != m_cache->stringAt( row[1] ) ||
+             dir.time != row[2] || dir.timeNsec != row[3] ) {
+            return false;
         }
+    }
 
-        list<string> packages;
-        split( pkgInput, ',', packages );
+    return true;
+}
 
+/*!
+  Init the repository from the ports directories in \a rootList,
+  taking as much as possible from the cache opened by initFromCache().
+
+  Ports directories which didn't change since the cache was written
+  aren't read at all. The ports in the other directories, and all ports
+  if \a checkPorts is true, are compared to the fingerprint stored in
+  the cache; only those which changed are read from their Pkgfile.
+  Duplicates are always registered, they're required to refresh the
+  cache once more.
+
+  If \a changedPorts is given, it's trusted to list all ports added,
+  removed or modified since the cache was written; only these are
+  checked then, unless the cache doesn't know a ports directory at all.
+  The listed paths and the ports directories are compared after
+  resolving symlinks and relative paths.
 
+  \param rootList a list of directories to look for ports in
+  \param checkPorts whether unchanged directories should be checked too
+  \param changedPorts the paths of the changed port directories
+  \param unknownPorts receives the paths in \a changedPorts which aren't
+  in any of the ports directories; the cache must not be written then,
+  as it would claim these ports to be current
+  \return the number of ports which have to be read from their Pkgfile
+*/
+size_t Repository::refresh( const list< pair<string, string> >& rootList,
+                            bool checkPorts,
+                            const list<string>* changedPorts,
+                            list<string>* unknownPorts )
+{
+    clear();
 
-        // TODO: think about whether it would be faster (more
-        // efficient) to put all packages into a map, and the iterate
-        // over the list of allowed packages and copy them
-        // over. depending in the efficiency of find(), this might be
-        // faster
-        d = opendir( path.c_str() );
-        while ( ( de = readdir( d ) ) != NULL ) {
-            name = de->d_name;
+    map<string, CachedDir> cachedDirs;
+    if ( m_cache ) {
+        indexCache( cachedDirs );
+    }
 
-            // TODO: review this
-            struct stat buf;
-            if ( stat( (path + "/" + name + "/Pkgfile").c_str(), &buf )
-                 != 0 ) {
-                // no Pkgfile -> no port
+    // changed ports by canonical ports directory, and the paths listed
+    // for that directory
+    map< string, set<string> > changedDirs;
+    map< string, list<string> > listedPaths;
+    if ( changedPorts ) {
+        list<string>::const_iterator cit = changedPorts->begin();
+        for ( ; cit != changedPorts->end(); ++cit ) {
+            string path = *cit;
+            while ( path.length() > 1 && path[path.length()-1] == '/' ) {
+                path.erase( path.length() - 1 );
+            }
+
+            // the port itself may be gone, its ports directory is not
+            string::size_type pos = path.rfind( '/' );
+            string dir = ".";
+            if ( pos == 0 ) {
+                dir = "/";
+            } else if ( pos != string::npos ) {
+                dir = path.substr( 0, pos );
+            }
+            dir = canonicalPath( dir );
+            changedDirs[dir].insert( path.substr( pos + 1 ) );
+            listedPaths[dir].push_back( *cit );
+        }
+    }
+
+    map<string, bool> alreadyChecked;
+    vector<FoundPort> found;
+
+    list< pair<string, string> >::const_iterator it = rootList.begin();
+    for ( ; it != rootList.end(); ++it ) {
+        PortsDir dir;
+        dir.path = it->first;
+        dir.filter = it->second;
+        readDirTime( dir.path, dir );
+        m_portsDirs.push_back( dir );
+
+        if ( alreadyChecked[dir.path] ) {
+            continue;
+        }
+
+        PortFilter filter;
+        filter.parse( dir.filter );
+        if ( !filter.isActive() ) {
+            alreadyChecked[dir.path] = true;
+        }
+
+        const CachedDir* cached = 0;
+        map<string, CachedDir>::const_iterator cit =
+            cachedDirs.find( dir.path );
+        if ( cit != cachedDirs.end() ) {
+            cached = &cit->second;
+        }
+
+        const set<string>* listed = 0;
+        string canonicalDir = canonicalPath( dir.path );
+        map< string, set<string> >::const_iterator lit =
+            changedDirs.find( canonicalDir );
+        if ( lit != changedDirs.end() ) {
+            listed = &lit->second;
+            listedPaths.erase( canonicalDir );
+        }
+
+        // opened for clean directories as well, ports are stat()ed
+        // relative to it
+        PortScanner scanner;
+        bool opened = scanner.open( dir.path );
+
+        vector<string> names;
+        bool clean = cached && isDirClean( dir, changedPorts != 0 );
+        if ( clean ) {
+            CachedDir::const_iterator pit = cached->begin();
+            for ( ; pit != cached->end(); ++pit ) {
+                names.push_back( pit->first );
+            }
+            if ( listed ) {
+                set<string>::const_iterator sit = listed->begin();
+                for ( ; sit != listed->end(); ++sit ) {
+                    if ( cached->find( *sit ) == cached->end() ) {
+                        names.push_back( *sit );
+                    }
+                }
+            }
+        } else {
+            if ( !opened ) {
                 continue;
             }
+            scanner.candidates( filter, names );
+        }
 
-            if ( filter && find( packages.begin(),
-                                 packages.end(), name ) == packages.end() ) {
-                // not found -> ignore this port
+        vector<string>::const_iterator nit = names.begin();
+        for ( ; nit != names.end(); ++nit ) {
+            const string& name = *nit;
+            if ( !filter.matches( name ) ) {
                 continue;
             }
 
-            if ( name != "." && name != ".." ) {
-
-                map<string, Package*>::iterator hidden;
-                hidden = m_packageMap.find( name );
-                Package* p = new Package( name, path );
-                if ( p ) {
-                    if ( hidden == m_packageMap.end() ) {
-                        // no such package found, add
-                        m_packageMap[name] = p;
-                    } else if ( listDuplicate ) {
-                        m_shadowedPackages.push_back(
-                                make_pair( p, hidden->second ));
-                    } else {
-                        delete p;
-                    }
+            const CachedPort* port = 0;
+            if ( cached ) {
+                CachedDir::const_iterator pit = cached->find( name );
+                if ( pit != cached->end() ) {
+                    port = &pit->second;
                 }
             }
+
+            FoundPort entry;
+            entry.listed = listed && listed->count( name );
+            if ( clean && !checkPorts && port && !entry.listed ) {
+                entry.fingerprint = port->fingerprint;
+            } else if ( !scanner.readFingerprint( name.c_str(),
+                                                  entry.fingerprint ) ) {
+                // no Pkgfile -> no port
+                continue;
+            }
+            entry.name = name;
+            entry.dir = m_portsDirs.size() - 1;
+            entry.port = port;
+            found.push_back( entry );
+        }
+    }
+
+    if ( unknownPorts ) {
+        unknownPorts->clear();
+        map< string, list<string> >::const_iterator uit =
+            listedPaths.begin();
+        for ( ; uit != listedPaths.end(); ++uit ) {
+            unknownPorts->insert( unknownPorts->end(),
+                                  uit->second.begin(), uit->second.end() );
+        }
+    }
+
+    // ports of the same name end up next to each other, in the order of
+    // their directories; the first one wins
+    stable_sort( found.begin(), found.end(), compareFoundPort );
+
+    // versions evaluated for the cache are wrong if evaluating is
+    // disabled now; records not evaluated yet are flagged when read
+    bool evaluatedStale = m_cache && !ShellEvaluator::isEnabled() &&
+        cacheEvaluatedVersions();
+
+    size_t changed = 0;
+    m_packages.reserve( found.size() );
+    Package* winner = 0;
+    vector<FoundPort>::const_iterator fit = found.begin();
+    for ( ; fit != found.end(); ++fit ) {
+        const CachedPort* port = fit->port;
+        const string& path = m_portsDirs[fit->dir].path;
+        bool shadowed = winner && winner->name() == fit->name;
+        bool unchanged = port && port->fingerprint == fit->fingerprint &&
+            !fit->listed;
+        if ( unchanged && evaluatedStale &&
+             ( !port->hasRecord ||
+               ( m_cache->flags( port->cacheIndex ) &
+                 CacheFile::VERSION_EVALUATED ) ) ) {
+            unchanged = false;
+        }
+
+        Package* p;
+        void* mem = m_arena.allocate();
+        if ( !shadowed && unchanged && port->hasRecord ) {
+            p = new ( mem ) Package( m_cache, port->cacheIndex );
+        } else if ( shadowed && unchanged ) {
+            // shadowed ports only need a version
+            const char* version = port->version;
+            const char* release = port->release;
+            if ( port->hasRecord ) {
+                version =
+                    m_cache->field( port->cacheIndex, CacheFile::VERSION );
+                release =
+                    m_cache->field( port->cacheIndex, CacheFile::RELEASE );
+            }
+            p = new ( mem ) Package( fit->name, path, version, release,
+                                     "", "", "", "", "", "", "", "" );
+        } else {
+            p = new ( mem ) Package( fit->name, path );
+            if ( !shadowed ) {
+                ++changed;
+            }
+        }
+        p->setFingerprint( fit->fingerprint );
+
+        if ( shadowed ) {
+            m_shadowedPackages.push_back( make_pair( p, winner ) );
+        } else {
+            m_packages.push_back( p );
+            winner = p;
         }
-        closedir( d );
     }
+    m_allFromCache = true;
 
-    m_shadowedPackages.sort(compareShadowPair);
+    return changed;
 }
 
 /*!
-  Init from a cache file
-  \param cacheFile the name of the cache file to be parser
-  \return true on success, false indicates file opening problems
+  \return \a path with symlinks and relative components resolved, or
+  without trailing slashes if it doesn't exist
 */
-Repository::CacheReadResult
-Repository::initFromCache( const string& cacheFile )
+string Repository::canonicalPath( const string& path )
 {
-    FILE* fp = fopen( cacheFile.c_str(), "r" );
-    if ( !fp ) {
-        return ACCESS_ERR;
+    char* resolved = realpath( path.c_str(), 0 );
+    if ( resolved ) {
+        string result = resolved;
+        free( resolved );
+        return result;
+    }
+
+    string result = path;
+    while ( result.length() > 1 && result[result.length()-1] == '/' ) {
+        result.erase( result.length() - 1 );
     }
+    return result;
+}
 
-    const int length = BUFSIZ;
-    char input[length];
-    string line;
+/*!
+  \return whether ShellEvaluator was enabled when the cache was written
+*/
+bool Repository::cacheEvaluatedVersions() const
+{
+    uint32_t rows = 0;
+    const uint32_t* row =
+        m_cache->table( CacheFile::EVAL_VERSIONS,
+                        CacheFile::EVAL_VERSIONS_ROW, rows );
+    return row && rows == 1 && row[0] != 0;
+}
+
+/*!
+  stat \a path and store its modification time in \a dir; the time is
+  zero if \a path doesn't exist
+  \return whether \a path exists
+*/
+bool Repository::readDirTime( const string& path, PortsDir& dir )
+{
+    struct stat buf;
+    if ( stat( path.c_str(), &buf ) != 0 ) {
+        dir.time = 0;
+        dir.timeNsec = 0;
+        return false;
+    }
+
+    dir.time = buf.st_mtim.tv_sec;
+    dir.timeNsec = buf.st_mtim.tv_nsec;
+    return true;
+}
+
+/*!
+  collect the ports stored in the cache, by ports directory and name
+*/
+void Repository::indexCache( map<string, CachedDir>& dirs ) const
+{
+    size_t count = m_cache->packageCount();
+    uint32_t rows = 0;
+    const uint32_t* fingerprints =
+        m_cache->table( CacheFile::FINGERPRINTS,
+                        CacheFile::FINGERPRINT_ROW, rows );
+    if ( rows != count ) {
+        fingerprints = 0;
+    }
 
-    // read version
-    if ( fgets( input, length, fp ) ) {
-        line = stripWhiteSpace( input );
-        if ( line != CACHE_VERSION ) {
-            return FORMAT_ERR;
+    for ( size_t i = 0; i < count; ++i ) {
+        CachedPort& port =
+            dirs[m_cache->field( i, CacheFile::PATH )]
+                [m_cache->field( i, CacheFile::NAME )];
+        port.hasRecord = true;
+        port.cacheIndex = i;
+        if ( fingerprints ) {
+            port.fingerprint = fingerprintFromRow(
+                fingerprints + i * CacheFile::FINGERPRINT_ROW );
         }
     }
 
-    // FIELDS:
-    // name, path, version, release,
-    // description, dependencies, url,
-    // packager, maintainer, hasReadme;
-    // hasPreInstall, hasPostInstall
-    const int fieldCount = 12;
-    string fields[fieldCount];
-    int fieldPos = 0;
+    const uint32_t* row =
+        m_cache->table( CacheFile::SHADOWED, CacheFile::SHADOWED_ROW, rows );
+    if ( !row ) {
+        return;
+    }
+    for ( uint32_t i = 0; i < rows; ++i, row += CacheFile::SHADOWED_ROW ) {
+        CachedDir& dir = dirs[m_cache->stringAt( row[1] )];
+        string name = m_cache->stringAt( row[0] );
+        if ( dir.find( name ) == dir.end() ) {
+            CachedPort& port = dir[name];
+            port.version = m_cache->stringAt( row[2] );
+            port.release = m_cache->stringAt( row[3] );
+            port.fingerprint = fingerprintFromRow( row + 4 );
+        }
+    }
+}
 
-    while ( fgets( input, length, fp ) ) {
-        line = StringHelper::stripWhiteSpace( input );
+/*!
+  \return true if the cache has a complete listing of \a dir, and the
+  directory wasn't modified since (unless \a ignoreTime is true)
+*/
+bool Repository::isDirClean( const PortsDir& dir, bool ignoreTime ) const
+{
+    // without the shadowed ports, the listing is not complete
+    uint32_t shadowedRows;
+    if ( !m_cache->table( CacheFile::SHADOWED,
+                          CacheFile::SHADOWED_ROW, shadowedRows ) ) {
+        return false;
+    }
 
-        fields[fieldPos] = line;
-        ++fieldPos;
-        if ( fieldPos == fieldCount ) {
-            fieldPos = 0;
-            Package* p = new Package( fields[0], fields[1],
-                                      fields[2], fields[3],
-                                      fields[4], fields[5], fields[6],
-                                      fields[7], fields[8], fields[9],
-                                      fields[10], fields[11]);
-            m_packageMap[p->name()] = p;
-            fgets( input, length, fp ); // read empty line
+    uint32_t rows = 0;
+    const uint32_t* row =
+        m_cache->table( CacheFile::ROOTS, CacheFile::ROOT_ROW, rows );
+    if ( !row ) {
+        return false;
+    }
+
+    for ( uint32_t i = 0; i < rows; ++i, row += CacheFile::ROOT_ROW ) {
+        if ( dir.path != m_cache->stringAt( row[0] ) ||
+             ( !ignoreTime &&
+               ( dir.time != row[2] || dir.timeNsec != row[3] ) ) ) {
+            continue;
+        }
+
+        // ports excluded by a filter aren't in the cache
+        const char* filter = m_cache->stringAt( row[1] );
+        if ( *filter == '\0' || dir.filter == filter ) {
+            return true;
         }
     }
-    fclose( fp );
 
-    return READ_OK;
+    return false;
 }
 
 /*!
@@ -306,56 +934,90 @@ Repository::WriteResult Repository::writeCache( const string& cacheFile )
         return DIR_ERR;
     }
 
-    FILE* fp = fopen( cacheFile.c_str(), "w" );
-    if ( !fp ) {
-        return FILE_ERR;
-    }
-
-    map<string, Package*>::const_iterator it = m_packageMap.begin();
-
-    char yesStr[] = "yes";
-    char noStr[] = "no";
-    char* hasReadme;
-    char* hasPreInstall;
-    char* hasPostInstall;
-
-    // write version
-    fprintf( fp, "%s\n", CACHE_VERSION.c_str() );
-
-    for ( ; it != m_packageMap.end(); ++it ) {
-        const Package* p = it->second;
-
-        // TODO: encode
-        hasReadme = noStr;
+    loadPackages();
+
+    CacheWriter writer;
+    uint32_t fields[CacheFile::FIELD_COUNT];
+    vector<uint32_t> fingerprints;
+    vector<string> texts;
+
+    const vector<Package*>& all = packages();
+    vector<Package*>::const_iterator it = all.begin();
+    for ( ; it != all.end(); ++it ) {
+        const Package* p = *it;
+
+        fields[CacheFile::NAME] = writer.addString( p->name() );
+        fields[CacheFile::PATH] = writer.addString( p->path() );
+        fields[CacheFile::VERSION] = writer.addString( p->version() );
+        fields[CacheFile::RELEASE] = writer.addString( p->release() );
+        fields[CacheFile::DESCRIPTION] =
+            writer.addString( p->description() );
+        fields[CacheFile::DEPENDS] = writer.addString( p->dependencies() );
+        fields[CacheFile::URL] = writer.addString( p->url() );
+        fields[CacheFile::PACKAGER] = writer.addString( p->packager() );
+        fields[CacheFile::MAINTAINER] = writer.addString( p->maintainer() );
+
+        uint32_t flags = 0;
         if ( p->hasReadme() ) {
-            hasReadme = yesStr;
+            flags |= CacheFile::HAS_README;
         }
-
-        hasPreInstall = noStr;
         if ( p->hasPreInstall() ) {
-            hasPreInstall = yesStr;
+            flags |= CacheFile::HAS_PRE_INSTALL;
         }
-
-        hasPostInstall = noStr;
         if ( p->hasPostInstall() ) {
-            hasPostInstall = yesStr;
+            flags |= CacheFile::HAS_POST_INSTALL;
         }
+        if ( p->versionEvaluated() ) {
+            flags |= CacheFile::VERSION_EVALUATED;
+        }
+        fields[CacheFile::FLAGS] = flags;
 
-        fprintf( fp, "%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n\n",
-                 p->name().c_str(),
-                 p->path().c_str(),
-                 p->version().c_str(),
+        writer.addPackage( fields );
+        appendFingerprint( fingerprints, p->fingerprint() );
+        texts.push_back( p->name() + "\n" + p->description() );
+    }
+    writer.addTable( CacheFile::FINGERPRINTS,
+                     CacheFile::FINGERPRINT_ROW, fingerprints );
+    TrigramIndex::write( writer, texts );
+    writer.addTable( CacheFile::EVAL_VERSIONS, CacheFile::EVAL_VERSIONS_ROW,
+                     vector<uint32_t>( 1, ShellEvaluator::isEnabled() ) );
+
+    if ( !m_portsDirs.empty() ) {
+        vector<uint32_t> roots;
+        vector<PortsDir>::const_iterator dit = m_portsDirs.begin();
+        for ( ; dit != m_portsDirs.end(); ++dit ) {
+            roots.push_back( writer.addString( dit->path ) );
+            roots.push_back( writer.addString( dit->filter ) );
+            roots.push_back( dit->time );
+            roots.push_back( dit->timeNsec );
+        }
+        writer.addTable( CacheFile::ROOTS, CacheFile::ROOT_ROW, roots );
 
-                 p->release().c_str(),
-                 p->description().c_str(),
-                 p->dependencies().c_str(),
-                 p->url().c_str(),
-                 p->packager().c_str(),
-                 p->maintainer().c_str(),
-                 hasReadme, hasPreInstall, hasPostInstall );
+        vector<const Package*> shadowedPorts;
+        vector< pair<Package*, Package*> >::const_iterator sit =
+            m_shadowedPackages.begin();
+        for ( ; sit != m_shadowedPackages.end(); ++sit ) {
+            shadowedPorts.push_back( sit->first );
+        }
+        loadPackages( shadowedPorts, Package::VERSION_FIELDS );
+
+        vector<uint32_t> shadowed;
+        for ( sit = m_shadowedPackages.begin();
+              sit != m_shadowedPackages.end(); ++sit ) {
+            const Package* p = sit->first;
+            shadowed.push_back( writer.addString( p->name() ) );
+            shadowed.push_back( writer.addString( p->path() ) );
+            shadowed.push_back( writer.addString( p->version() ) );
+            shadowed.push_back( writer.addString( p->release() ) );
+            appendFingerprint( shadowed, p->fingerprint() );
+        }
+        writer.addTable( CacheFile::SHADOWED,
+                         CacheFile::SHADOWED_ROW, shadowed );
     }
 
-    fclose( fp );
+    if ( !writer.write( cacheFile ) ) {
+        return FILE_ERR;
+    }
     return SUCCESS;
 }
 
@@ -401,21 +1063,21 @@ bool Repository::createOutputDir( const string& path )
 void Repository::getMatchingPackages( const string& pattern,
                                       list<Package*>& target ) const
 {
-    map<string, Package*>::const_iterator it = m_packageMap.begin();
+    const vector<Package*>& all = packages();
+    vector<Package*>::const_iterator it = all.begin();
     RegEx re(pattern);
 
     if (m_useRegex) {
-        for ( ; it != m_packageMap.end(); ++it ) {
-            if (re.match(it->first)) {
-                target.push_back( it->second );
+        for ( ; it != all.end(); ++it ) {
+            if (re.match((*it)->name())) {
+                target.push_back( *it );
             }
         }
     } else {
-        for ( ; it != m_packageMap.end(); ++it ) {
-            // I assume fnmatch will be quite fast for "match all" (*), so
-            // I didn't add a boolean to check for this explicitely
-            if ( fnmatch( pattern.c_str(), it->first.c_str(), 0  ) == 0 ) {
-                target.push_back( it->second );
+        GlobPattern glob( pattern );
+        for ( ; it != all.end(); ++it ) {
+            if ( glob.match( (*it)->name() ) ) {
+                target.push_back( *it );
             }
         }
     }
@@ -425,10 +1087,8 @@ void Repository::addDependencies( std::map<string, string>& deps )
 {
     map<string, string>::iterator it = deps.begin();
     for ( ; it != deps.end(); ++it ) {
-        map<string, Package*>::const_iterator pit =
-            m_packageMap.find( it->first );
-        if ( pit != m_packageMap.end() ) {
-            Package* p = pit->second;
+        Package* p = findPackage( it->first );
+        if ( p ) {
             if (p->dependencies().length() == 0) {
                 // only use if no dependencies in Pkgfile
                 p->setDependencies(it->second);
@@ -15,10 +15,15 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 #include <utility>
 using namespace std;
 
 #include "package.h"
+#include "packagestore.h"
+#include "pkgfilereader.h"
+
+class CacheFile;
 
 /*!
   \class Repository
@@ -33,8 +38,8 @@ public:
     ~Repository();
 
     const Package* getPackage( const string& name ) const;
-    const map<string, Package*>& packages() const;
-    const list<pair<Package*, Package*> >& shadowedPackages() const;
+    const vector<Package*>& packages() const;
+    const vector< pair<Package*, Package*> >& shadowedPackages() const;
 
     void searchMatchingPackages( const string& pattern,
                                  list<Package*>& target,
@@ -46,6 +51,12 @@ public:
     void initFromFS( const list< pair<string, string> >& rootList,
                      bool listDuplicate );
 
+    void loadPackages() const;
+    void loadPackages( const list<Package*>& packages,
+                       unsigned int fields = Package::ALL_FIELDS ) const;
+    void loadPackages( const list<const Package*>& packages,
+                       unsigned int fields = Package::ALL_FIELDS ) const;
+
 
      /*! Result of a cache write operation */
     enum CacheReadResult {
@@ -54,6 +65,11 @@ public:
         READ_OK    /*!< Success */
     };
     CacheReadResult initFromCache( const string& cacheFile );
+    bool isCacheCurrent( const list< pair<string, string> >& rootList ) const;
+    size_t refresh( const list< pair<string, string> >& rootList,
+                    bool checkPorts,
+                    const list<string>* changedPorts = 0,
+                    list<string>* unknownPorts = 0 );
 
     /*! Result of a cache write operation */
     enum WriteResult {
@@ -67,14 +83,83 @@ public:
     void addDependencies( std::map<string, string>& deps );
 
 private:
-    static int compareShadowPair(pair<Package*, Package*>& p1,
-                                 pair<Package*, Package*>& p2);
+    /*! a ports directory as configured, and its modification time */
+    struct PortsDir
+    {
+        string path;
+        string filter;
+        uint32_t time;
+        uint32_t timeNsec;
+    };
+
+    /*! a port listed in the cache */
+    struct CachedPort
+    {
+        CachedPort();
+
+        bool hasRecord;     /*!< false for shadowed ports */
+        size_t cacheIndex;
+        PortFingerprint fingerprint;
+        const char* version;    /*!< for shadowed ports */
+        const char* release;
+    };
+
+    typedef map<string, CachedPort> CachedDir;
+
+    /*! a port found in a ports directory, before its package is created */
+    struct FoundPort
+    {
+        string name;
+        size_t dir;     /*!< index of its ports directory */
+        const CachedPort* port;
+        PortFingerprint fingerprint;
+        bool listed;    /*!< listed as changed */
+    };
+
+    Package* findPackage( const string& name ) const;
+    Package* newShadowedPackage( const uint32_t* row ) const;
+
+    static bool readDirTime( const string& path, PortsDir& dir );
+    static string canonicalPath( const string& path );
+    void indexCache( map<string, CachedDir>& dirs ) const;
+    bool isDirClean( const PortsDir& dir, bool ignoreTime ) const;
+    bool cacheEvaluatedVersions() const;
+    void clear();
+
+    /*! the packages passed to loadPackageJob() */
+    struct LoadJob
+    {
+        unsigned int fields;    /*!< the Package::FieldGroups to load */
+        vector<const Package*> packages;
+        vector<PortFiles> files;    /*!< files of the first packages */
+        vector<const Package*> others;
+    };
+
+    static void loadPackages( const vector<const Package*>& packages,
+                              unsigned int fields );
+    static void loadPackageJob( size_t index, void* data );
+    static void evaluateVersions( const vector<const Package*>& packages );
+
+    static bool comparePackageName( const Package* p, const string& name );
+    static bool compareFoundPort( const FoundPort& p1,
+                                  const FoundPort& p2 );
 
-    static const std::string CACHE_VERSION;
     bool m_useRegex;
 
-    list<pair<Package*, Package*> > m_shadowedPackages;
-    map<string, Package*> m_packageMap;
+    // read from the cache on first access, unless m_shadowedRead is set
+    mutable vector< pair<Package*, Package*> > m_shadowedPackages;
+    mutable bool m_shadowedRead;
+
+    // ports directories scanned by refresh(), stored in the cache
+    vector<PortsDir> m_portsDirs;
+
+    // all packages, sorted by name. When reading from a cache, packages
+    // are only created when they're accessed, and stored at their index
+    // in the cache; m_allFromCache is set once all of them are created
+    mutable PackageArena m_arena;
+    mutable vector<Package*> m_packages;
+    CacheFile* m_cache;
+    mutable bool m_allFromCache;
 };
 
 #endif /* _REPOSITORY_H_ */
@@ -0,0 +1,387 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        shellevaluator.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+using namespace std;
+
+#include <sys/types.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <poll.h>
+#include <pwd.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "shellevaluator.h"
+#include "workerpool.h"
+
+namespace
+{
+    const char SHELL[] = "/bin/sh";
+
+    // The protocol: prt-get writes one port directory per line; for
+    // each of them, the shell answers with the NUL terminated fields
+    // 'V<version>' and 'R<release>', if the Pkgfile could be sourced,
+    // followed by 'E'. Pkgfiles can't grow files or use up more than a
+    // few seconds of CPU time; see startWorker() for further limits.
+    const char SCRIPT[] =
+        "while IFS= read -r dir; do\n"
+        "    (\n"
+        "        ulimit -t 5 2>/dev/null\n"
+        "        ulimit -f 0 2>/dev/null\n"
+        "        cd \"$dir\" || exit 1\n"
+        "        . ./Pkgfile >/dev/null 2>&1 </dev/null\n"
+        "        printf 'V%s\\000R%s\\000' \"$version\" \"$release\"\n"
+        "    ) 2>/dev/null </dev/null\n"
+        "    printf 'E\\000'\n"
+        "done\n";
+
+    const char* const ENVIRONMENT[] = {
+        "PATH=/usr/sbin:/usr/bin:/sbin:/bin",
+        "HOME=/",
+        "LC_ALL=C",
+        0
+    };
+
+    const unsigned int MAX_WORKERS = 4;
+
+    // the user the shells run as if prt-get is run by root
+    const char UNPRIVILEGED_USER[] = "nobody";
+
+    // processes the shells may have if they run as UNPRIVILEGED_USER
+    const rlim_t MAX_PROCESSES = 64;
+
+    // wall clock time a single Pkgfile may take, in seconds
+    const int TIMEOUT = 10;
+
+    bool enabled = false;
+
+    double now()
+    {
+        struct timespec ts;
+        clock_gettime( CLOCK_MONOTONIC, &ts );
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    bool writeAll( int fd, const string& data )
+    {
+        size_t written = 0;
+        while ( written < data.length() ) {
+            ssize_t count = write( fd, data.data() + written,
+                                   data.length() - written );
+            if ( count < 0 && errno == EINTR ) {
+                continue;
+            }
+            if ( count <= 0 ) {
+                return false;
+            }
+            written += count;
+        }
+        return true;
+    }
+}
+
+/*! a shell evaluating Pkgfiles */
+struct ShellEvaluator::Worker
+{
+    Worker() : pid( -1 ), in( -1 ), out( -1 ), busy( false ) {}
+
+    pid_t pid;
+    int in;         /*!< writing end of the shell's stdin */
+    int out;        /*!< reading end of the shell's stdout */
+    string buffer;  /*!< output of the shell not handled yet */
+
+    bool busy;
+    size_t request;
+    double deadline;
+};
+
+
+EvaluatedVersion::EvaluatedVersion()
+    : valid( false )
+{
+}
+
+/*!
+  set whether Pkgfiles may be evaluated at all
+*/
+void ShellEvaluator::setEnabled( bool enable )
+{
+    enabled = enable;
+}
+
+/*! \return whether Pkgfiles may be evaluated */
+bool ShellEvaluator::isEnabled()
+{
+    return enabled;
+}
+
+/*!
+  evaluate the Pkgfiles in \a portDirs
+  \param portDirs the directories of the ports to evaluate
+  \param results receives the version and release of each port
+*/
+void ShellEvaluator::evaluate( const vector<string>& portDirs,
+                               vector<EvaluatedVersion>& results )
+{
+    results.assign( portDirs.size(), EvaluatedVersion() );
+    if ( !enabled || portDirs.empty() || access( SHELL, X_OK ) != 0 ) {
+        return;
+    }
+
+    // a shell dying would otherwise kill us when writing to it
+    struct sigaction ignore;
+    struct sigaction oldAction;
+    memset( &ignore, 0, sizeof( ignore ) );
+    ignore.sa_handler = SIG_IGN;
+    sigaction( SIGPIPE, &ignore, &oldAction );
+
+    size_t count = WorkerPool::defaultThreadCount();
+    if ( count > MAX_WORKERS ) {
+        count = MAX_WORKERS;
+    }
+    if ( count > portDirs.size() ) {
+        count = portDirs.size();
+    }
+    vector<Worker> workers( count );
+
+    size_t next = 0;
+    for ( ;; ) {
+        for ( size_t i = 0; i < workers.size(); ++i ) {
+            Worker& worker = workers[i];
+            while ( !worker.busy && next < portDirs.size() ) {
+                size_t request = next++;
+                if ( portDirs[request].find( '\n' ) != string::npos ) {
+                    continue;
+                }
+                if ( worker.pid == -1 && !startWorker( worker ) ) {
+                    continue;
+                }
+                if ( !writeAll( worker.in, portDirs[request] + "\n" ) ) {
+                    stopWorker( worker, true );
+                    continue;
+                }
+                worker.busy = true;
+                worker.request = request;
+                worker.deadline = now() + TIMEOUT;
+            }
+        }
+
+        vector<struct pollfd> fds;
+        vector<Worker*> polled;
+        double deadline = 0;
+        for ( size_t i = 0; i < workers.size(); ++i ) {
+            if ( workers[i].busy ) {
+                struct pollfd fd;
+                fd.fd = workers[i].out;
+                fd.events = POLLIN;
+                fd.revents = 0;
+                fds.push_back( fd );
+                polled.push_back( &workers[i] );
+                if ( deadline == 0 || workers[i].deadline < deadline ) {
+                    deadline = workers[i].deadline;
+                }
+            }
+        }
+        if ( fds.empty() ) {
+            break;
+        }
+
+        int timeout = (int)( ( deadline - now() ) * 1000 ) + 1;
+        if ( poll( &fds[0], fds.size(), timeout < 0 ? 0 : timeout ) < 0 &&
+             errno != EINTR ) {
+            break;
+        }
+
+        for ( size_t i = 0; i < fds.size(); ++i ) {
+            Worker& worker = *polled[i];
+            if ( fds[i].revents ) {
+                char buf[4096];
+                ssize_t length = read( worker.out, buf, sizeof( buf ) );
+                if ( length < 0 && errno == EINTR ) {
+                    continue;
+                }
+                if ( length <= 0 ) {
+                    stopWorker( worker, true );
+                    continue;
+                }
+                worker.buffer.append( buf, length );
+                if ( parseResponse( worker, results[worker.request] ) ) {
+                    worker.busy = false;
+                    continue;
+                }
+            }
+            if ( now() > worker.deadline ) {
+                stopWorker( worker, true );
+            }
+        }
+    }
+
+    for ( size_t i = 0; i < workers.size(); ++i ) {
+        stopWorker( workers[i], workers[i].busy );
+    }
+
+    sigaction( SIGPIPE, &oldAction, 0 );
+}
+
+/*!
+  start a shell for \a worker
+  \return whether the shell could be started
+*/
+bool ShellEvaluator::startWorker( Worker& worker )
+{
+    int in[2];
+    int out[2];
+    if ( pipe2( in, O_CLOEXEC ) != 0 ) {
+        return false;
+    }
+    if ( pipe2( out, O_CLOEXEC ) != 0 ) {
+        close( in[0] );
+        close( in[1] );
+        return false;
+    }
+    // Pkgfiles are code from the ports tree, which root shouldn't run;
+    // looked up here, getpwnam() isn't safe to be used after fork()
+    bool dropPrivileges = geteuid() == 0;
+    uid_t uid = 0;
+    gid_t gid = 0;
+    if ( dropPrivileges ) {
+        struct passwd* pw = getpwnam( UNPRIVILEGED_USER );
+        if ( !pw || pw->pw_uid == 0 ) {
+            close( in[0] );
+            close( in[1] );
+            close( out[0] );
+            close( out[1] );
+            return false;
+        }
+        uid = pw->pw_uid;
+        gid = pw->pw_gid;
+    }
+
+    int devNull = open( "/dev/null", O_RDWR | O_CLOEXEC );
+
+    const char* const argv[] = { "sh", "-c", SCRIPT, 0 };
+    pid_t pid = fork();
+    if ( pid == 0 ) {
+        // own session and process group, so a shell which timed out
+        // can be killed together with whatever it started
+        setsid();
+        dup2( in[0], 0 );
+        dup2( out[1], 1 );
+        if ( devNull != -1 ) {
+            dup2( devNull, 2 );
+        }
+
+        struct rlimit limit;
+        limit.rlim_cur = limit.rlim_max = 0;
+        setrlimit( RLIMIT_CORE, &limit );
+
+        if ( dropPrivileges ) {
+            // no network; this requires root, so it's done first
+            unshare( CLONE_NEWNET );
+            limit.rlim_cur = limit.rlim_max = MAX_PROCESSES;
+            setrlimit( RLIMIT_NPROC, &limit );
+            if ( setgroups( 0, 0 ) != 0 || setgid( gid ) != 0 ||
+                 setuid( uid ) != 0 || setuid( 0 ) != -1 ) {
+                _exit( 127 );
+            }
+        }
+        // setuid programs like sudo can't give privileges back
+        prctl( PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0 );
+
+        if ( chdir( "/" ) == 0 ) {
+            execve( SHELL, (char* const*)argv, (char* const*)ENVIRONMENT );
+        }
+        _exit( 127 );
+    }
+
+    close( in[0] );
+    close( out[1] );
+    if ( devNull != -1 ) {
+        close( devNull );
+    }
+    if ( pid == -1 ) {
+        close( in[1] );
+        close( out[0] );
+        return false;
+    }
+
+    worker.pid = pid;
+    worker.in = in[1];
+    worker.out = out[0];
+    worker.buffer.clear();
+    worker.busy = false;
+    return true;
+}
+
+/*!
+  stop the shell of \a worker; a new one is started when required. If
+  \a kill is true, the shell is killed instead of being asked to exit
+*/
+void ShellEvaluator::stopWorker( Worker& worker, bool kill )
+{
+    if ( worker.pid == -1 ) {
+        return;
+    }
+
+    if ( kill ) {
+        ::kill( -worker.pid, SIGKILL );
+    }
+    close( worker.in );
+    close( worker.out );
+    while ( waitpid( worker.pid, 0, 0 ) < 0 && errno == EINTR ) {
+    }
+
+    worker.pid = -1;
+    worker.in = -1;
+    worker.out = -1;
+    worker.buffer.clear();
+    worker.busy = false;
+}
+
+/*!
+  parse the answer of \a worker to its current request into \a result
+  \return false if the answer is not complete yet
+*/
+bool ShellEvaluator::parseResponse( Worker& worker,
+                                    EvaluatedVersion& result )
+{
+    bool hasVersion = false;
+    bool hasRelease = false;
+    string::size_type pos = 0;
+    for ( ;; ) {
+        string::size_type end = worker.buffer.find( '\0', pos );
+        if ( end == string::npos ) {
+            return false;
+        }
+
+        const char* field = worker.buffer.c_str() + pos;
+        if ( field[0] == 'V' ) {
+            result.version.assign( field + 1, end - pos - 1 );
+            hasVersion = true;
+        } else if ( field[0] == 'R' ) {
+            result.release.assign( field + 1, end - pos - 1 );
+            hasRelease = true;
+        } else if ( field[0] == 'E' ) {
+            result.valid = hasVersion && hasRelease &&
+                !result.version.empty();
+            worker.buffer.erase( 0, end + 1 );
+            return true;
+        }
+        pos = end + 1;
+    }
+}
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        shellevaluator.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _SHELLEVALUATOR_H_
+#define _SHELLEVALUATOR_H_
+
+#include <string>
+#include <vector>
+
+/*!
+  version and release of a port, as set by its Pkgfile
+*/
+struct EvaluatedVersion
+{
+    EvaluatedVersion();
+
+    bool valid;     /*!< false if the Pkgfile couldn't be evaluated */
+    std::string version;
+    std::string release;
+};
+
+/*!
+  \class ShellEvaluator
+  \brief evaluates Pkgfiles using /bin/sh
+
+  Used for versions which ShellExpander can't handle, like ones using
+  variables. The Pkgfiles are sourced by a few long-lived shells which
+  read port directories from a pipe and answer with the version and
+  release; each Pkgfile is sourced in a subshell of its own, with a
+  minimal environment, no input and no output, and with time limits.
+  If prt-get runs as root, the shells run as user nobody, without
+  network access. This limits what a Pkgfile can do, but it's no
+  sandbox: it can still do anything the user it runs as may do.
+
+  Disabled unless enabled in the configuration; the Pkgfiles are left
+  alone then.
+*/
+class ShellEvaluator
+{
+public:
+    static void setEnabled( bool enabled );
+    static bool isEnabled();
+
+    static void evaluate( const std::vector<std::string>& portDirs,
+                          std::vector<EvaluatedVersion>& results );
+
+private:
+    struct Worker;
+
+    static bool startWorker( Worker& worker );
+    static void stopWorker( Worker& worker, bool kill );
+    static bool parseResponse( Worker& worker, EvaluatedVersion& result );
+};
+
+#endif /* _SHELLEVALUATOR_H_ */
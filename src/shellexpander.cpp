@@ -0,0 +1,229 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        shellexpander.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <cctype>
+#include <ctime>
+#include <map>
+#include <vector>
+using namespace std;
+
+#include <sys/utsname.h>
+#include <pthread.h>
+
+#include "shellexpander.h"
+
+namespace
+{
+    // what `date` prints without a format
+    const char DEFAULT_DATE_FORMAT[] = "%a %b %e %H:%M:%S %Z %Y";
+
+    // longest date accepted
+    const size_t MAX_DATE_LENGTH = 4096;
+
+    // the evaluation context, set up once by ShellExpander::init()
+    pthread_once_t contextOnce = PTHREAD_ONCE_INIT;
+    string kernelRelease;
+    struct tm localTime;
+    struct tm utcTime;
+
+    // formatted dates by format; the first character of the key tells
+    // whether it's local time or UTC
+    pthread_mutex_t dateLock = PTHREAD_MUTEX_INITIALIZER;
+    map<string, string> dates;
+
+    /*!
+      split \a command into words, removing quotes like the shell does
+      \return false if a quote is not closed
+    */
+    bool splitCommand( const string& command, vector<string>& words )
+    {
+        string word;
+        bool inWord = false;
+        char quote = '\0';
+        for ( string::size_type i = 0; i < command.length(); ++i ) {
+            char c = command[i];
+            if ( quote ) {
+                if ( c == quote ) {
+                    quote = '\0';
+                } else {
+                    word += c;
+                }
+            } else if ( c == '\'' || c == '"' ) {
+                quote = c;
+                inWord = true;
+            } else if ( isspace( (unsigned char)c ) ) {
+                if ( inWord ) {
+                    words.push_back( word );
+                    word.clear();
+                    inWord = false;
+                }
+            } else {
+                word += c;
+                inWord = true;
+            }
+        }
+
+        if ( inWord ) {
+            words.push_back( word );
+        }
+        return quote == '\0';
+    }
+}
+
+/*!
+  \return whether \a input may contain shell commands at all
+*/
+bool ShellExpander::needsExpansion( const string& input )
+{
+    return input.find_first_of( "`$" ) != string::npos;
+}
+
+/*!
+  replace the shell commands in \a input by their output
+*/
+void ShellExpander::expand( string& input )
+{
+    if ( !needsExpansion( input ) ) {
+        return;
+    }
+    pthread_once( &contextOnce, init );
+
+    string output;
+    string::size_type pos = 0;
+    while ( pos < input.length() ) {
+        string::size_type start = input.find_first_of( "`$", pos );
+        if ( start == string::npos ) {
+            break;
+        }
+
+        string::size_type commandStart;
+        string::size_type commandEnd;
+        if ( input[start] == '`' ) {
+            commandStart = start + 1;
+            commandEnd = input.find( '`', commandStart );
+        } else if ( input.compare( start, 2, "$(" ) == 0 ) {
+            commandStart = start + 2;
+            commandEnd = input.find( ')', commandStart );
+        } else {
+            output.append( input, pos, start + 1 - pos );
+            pos = start + 1;
+            continue;
+        }
+        if ( commandEnd == string::npos ) {
+            break;
+        }
+
+        output.append( input, pos, start - pos );
+        string result;
+        if ( evaluate( input.substr( commandStart,
+                                     commandEnd - commandStart ),
+                       result ) ) {
+            output += result;
+        } else {
+            output.append( input, start, commandEnd + 1 - start );
+        }
+        pos = commandEnd + 1;
+    }
+
+    if ( pos < input.length() ) {
+        output.append( input, pos, string::npos );
+    }
+    input.swap( output );
+}
+
+/*!
+  set up the evaluation context; called once per process
+*/
+void ShellExpander::init()
+{
+    struct utsname unameBuf;
+    if ( uname( &unameBuf ) == 0 ) {
+        kernelRelease = unameBuf.release;
+    }
+
+    time_t now = time( 0 );
+    localtime_r( &now, &localTime );
+    gmtime_r( &now, &utcTime );
+}
+
+/*!
+  evaluate the shell command \a command
+  \return false if \a command is not supported
+*/
+bool ShellExpander::evaluate( const string& command, string& result )
+{
+    vector<string> words;
+    if ( !splitCommand( command, words ) || words.empty() ) {
+        return false;
+    }
+
+    if ( words[0] == "uname" ) {
+        if ( words.size() == 2 && words[1] == "-r" ) {
+            result = kernelRelease;
+            return true;
+        }
+    } else if ( words[0] == "date" ) {
+        return evaluateDate( words, result );
+    }
+
+    return false;
+}
+
+/*!
+  evaluate the date command \a arguments, with arguments[0] being 'date'
+  \return false if the arguments are not supported
+*/
+bool ShellExpander::evaluateDate( const vector<string>& arguments,
+                                  string& result )
+{
+    bool utc = false;
+    string format;
+    bool hasFormat = false;
+    for ( size_t i = 1; i < arguments.size(); ++i ) {
+        const string& arg = arguments[i];
+        if ( arg == "-u" || arg == "--utc" || arg == "--universal" ) {
+            utc = true;
+        } else if ( arg[0] == '+' && !hasFormat ) {
+            format = arg.substr( 1 );
+            hasFormat = true;
+        } else {
+            return false;
+        }
+    }
+    if ( !hasFormat ) {
+        format = DEFAULT_DATE_FORMAT;
+    }
+
+    string key = ( utc ? "u" : "l" ) + format;
+    pthread_mutex_lock( &dateLock );
+    map<string, string>::iterator it = dates.find( key );
+    if ( it == dates.end() ) {
+        string date;
+        vector<char> buf( 64 );
+        while ( !format.empty() ) {
+            size_t length = strftime( &buf[0], buf.size(), format.c_str(),
+                                      utc ? &utcTime : &localTime );
+            if ( length > 0 ) {
+                date.assign( &buf[0], length );
+                break;
+            }
+            if ( buf.size() >= MAX_DATE_LENGTH ) {
+                break;
+            }
+            buf.resize( buf.size() * 2 );
+        }
+        it = dates.insert( make_pair( key, date ) ).first;
+    }
+    result = it->second;
+    pthread_mutex_unlock( &dateLock );
+
+    return true;
+}
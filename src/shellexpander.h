@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        shellexpander.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _SHELLEXPANDER_H_
+#define _SHELLEXPANDER_H_
+
+#include <string>
+#include <vector>
+
+/*!
+  \class ShellExpander
+  \brief expands shell commands in Pkgfile variables
+
+  Replaces `command` and $(command) for the commands commonly used in
+  versions: 'uname -r' and 'date' with an optional +format. Any number
+  of them may appear in one string; other commands are left as they are.
+
+  The system name and the current time are read once per process, and
+  formatted dates are remembered, so expanding the versions of many
+  ports doesn't cost any system calls. Safe to be used from multiple
+  threads.
+*/
+class ShellExpander
+{
+public:
+    static bool needsExpansion( const std::string& input );
+    static void expand( std::string& input );
+
+private:
+    static void init();
+    static bool evaluate( const std::string& command, std::string& result );
+    static bool evaluateDate( const std::vector<std::string>& arguments,
+                              std::string& result );
+};
+
+#endif /* _SHELLEXPANDER_H_ */
@@ -11,9 +11,166 @@
 
 #include "stringhelper.h"
 #include <cctype>
+#include <cstring>
+#include <fnmatch.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
+namespace
+{
+    // like tolower() in the C locale, which prt-get runs in
+    inline unsigned char foldCase( unsigned char c )
+    {
+        return ( c >= 'A' && c <= 'Z' ) ? c + ( 'a' - 'A' ) : c;
+    }
+
+    bool equalNoCase( const char* s1, const char* s2, size_t length )
+    {
+        for ( size_t i = 0; i < length; ++i ) {
+            if ( foldCase( s1[i] ) != foldCase( s2[i] ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    typedef size_t (*FindFunction)( const char*, size_t,
+                                    const char*, size_t );
+
+    size_t findNoCaseScalar( const char* s, size_t length,
+                             const char* pattern, size_t patternLength )
+    {
+        unsigned char first = foldCase( pattern[0] );
+        for ( size_t i = 0; i + patternLength <= length; ++i ) {
+            if ( foldCase( s[i] ) == first &&
+                 equalNoCase( s + i + 1, pattern + 1, patternLength - 1 ) ) {
+                return i;
+            }
+        }
+        return string::npos;
+    }
+
+    /*!
+      search the rest of \a s, starting at \a offset, with the scalar
+      version
+    */
+    size_t findNoCaseTail( const char* s, size_t length, size_t offset,
+                           const char* pattern, size_t patternLength )
+    {
+        size_t pos = findNoCaseScalar( s + offset, length - offset,
+                                       pattern, patternLength );
+        return pos == string::npos ? pos : offset + pos;
+    }
+
+    // The vectorised versions compare the first and the last character
+    // of the pattern with a block of positions at once, and only check
+    // the characters in between for the positions where both match.
+
+#if defined(__SSE2__)
+    inline __m128i foldCase128( __m128i c )
+    {
+        __m128i upper =
+            _mm_and_si128( _mm_cmpgt_epi8( c, _mm_set1_epi8( 'A' - 1 ) ),
+                           _mm_cmplt_epi8( c, _mm_set1_epi8( 'Z' + 1 ) ) );
+        return _mm_or_si128( c, _mm_and_si128( upper,
+                                               _mm_set1_epi8( 0x20 ) ) );
+    }
+
+    size_t findNoCaseSSE2( const char* s, size_t length,
+                           const char* pattern, size_t patternLength )
+    {
+        const __m128i first = _mm_set1_epi8( foldCase( pattern[0] ) );
+        const __m128i last =
+            _mm_set1_epi8( foldCase( pattern[patternLength-1] ) );
+        size_t inner = patternLength > 2 ? patternLength - 2 : 0;
+
+        size_t i = 0;
+        for ( ; i + patternLength + 15 <= length; i += 16 ) {
+            __m128i blockFirst = foldCase128(
+                _mm_loadu_si128( (const __m128i*)( s + i ) ) );
+            __m128i blockLast = foldCase128(
+                _mm_loadu_si128( (const __m128i*)
+                                 ( s + i + patternLength - 1 ) ) );
+            unsigned int mask = _mm_movemask_epi8(
+                _mm_and_si128( _mm_cmpeq_epi8( blockFirst, first ),
+                               _mm_cmpeq_epi8( blockLast, last ) ) );
+            while ( mask ) {
+                unsigned int bit = __builtin_ctz( mask );
+                if ( equalNoCase( s + i + bit + 1, pattern + 1, inner ) ) {
+                    return i + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+
+        return findNoCaseTail( s, length, i, pattern, patternLength );
+    }
+#endif
+
+#if defined(__x86_64__)
+    __attribute__(( target( "avx2" ) ))
+    inline __m256i foldCase256( __m256i c )
+    {
+        __m256i upper = _mm256_and_si256(
+            _mm256_cmpgt_epi8( c, _mm256_set1_epi8( 'A' - 1 ) ),
+            _mm256_cmpgt_epi8( _mm256_set1_epi8( 'Z' + 1 ), c ) );
+        return _mm256_or_si256( c, _mm256_and_si256(
+                                    upper, _mm256_set1_epi8( 0x20 ) ) );
+    }
+
+    __attribute__(( target( "avx2" ) ))
+    size_t findNoCaseAVX2( const char* s, size_t length,
+                           const char* pattern, size_t patternLength )
+    {
+        const __m256i first = _mm256_set1_epi8( foldCase( pattern[0] ) );
+        const __m256i last =
+            _mm256_set1_epi8( foldCase( pattern[patternLength-1] ) );
+        size_t inner = patternLength > 2 ? patternLength - 2 : 0;
+
+        size_t i = 0;
+        for ( ; i + patternLength + 31 <= length; i += 32 ) {
+            __m256i blockFirst = foldCase256(
+                _mm256_loadu_si256( (const __m256i*)( s + i ) ) );
+            __m256i blockLast = foldCase256(
+                _mm256_loadu_si256( (const __m256i*)
+                                    ( s + i + patternLength - 1 ) ) );
+            unsigned int mask = _mm256_movemask_epi8(
+                _mm256_and_si256( _mm256_cmpeq_epi8( blockFirst, first ),
+                                  _mm256_cmpeq_epi8( blockLast, last ) ) );
+            while ( mask ) {
+                unsigned int bit = __builtin_ctz( mask );
+                if ( equalNoCase( s + i + bit + 1, pattern + 1, inner ) ) {
+                    return i + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+
+        return findNoCaseTail( s, length, i, pattern, patternLength );
+    }
+#endif
+
+    /*! \return the fastest version supported by this CPU */
+    FindFunction selectFindNoCase()
+    {
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports( "avx2" ) ) {
+            return findNoCaseAVX2;
+        }
+#endif
+#if defined(__SSE2__)
+        return findNoCaseSSE2;
+#else
+        return findNoCaseScalar;
+#endif
+    }
+}
+
 namespace StringHelper
 {
 
@@ -155,5 +312,92 @@ string replaceAll( string& in,
     return in;
 }
 
+/*!
+  find \a pattern in the first \a length characters of \a s, ignoring
+  the case of ASCII letters. Uses SSE2 or AVX2 if available
+  \return the position of the first match, or string::npos
+*/
+size_t findNoCase( const char* s, size_t length,
+                   const char* pattern, size_t patternLength )
+{
+    static const FindFunction find = selectFindNoCase();
+
+    if ( patternLength == 0 ) {
+        return 0;
+    }
+    if ( patternLength > length ) {
+        return string::npos;
+    }
+    return find( s, length, pattern, patternLength );
+}
+
+/*!
+  \return whether \a s contains \a pattern, ignoring the case of ASCII
+  letters; the same as toLowerCase( s ).find( toLowerCase( pattern ) ),
+  without copying anything
+*/
+bool containsNoCase( const string& s, const string& pattern )
+{
+    return findNoCase( s.data(), s.length(),
+                       pattern.data(), pattern.length() ) != string::npos;
+}
+
+
+GlobPattern::GlobPattern( const string& pattern )
+    : m_pattern( pattern ),
+      m_kind( GENERIC )
+{
+    string::size_type begin = pattern.find_first_not_of( '*' );
+    if ( begin == string::npos ) {
+        m_kind = pattern.empty() ? EXACT : MATCH_ALL;
+        return;
+    }
+    string::size_type end = pattern.find_last_not_of( '*' ) + 1;
+
+    m_literal = pattern.substr( begin, end - begin );
+    if ( m_literal.find_first_of( "*?[\\" ) != string::npos ) {
+        m_literal = pattern.substr( 0, pattern.find_first_of( "*?[\\" ) );
+        return;
+    }
+
+    bool leadingStar = begin > 0;
+    bool trailingStar = end < pattern.length();
+    if ( leadingStar && trailingStar ) {
+        m_kind = SUBSTRING;
+    } else if ( leadingStar ) {
+        m_kind = SUFFIX;
+    } else if ( trailingStar ) {
+        m_kind = PREFIX;
+    } else {
+        m_kind = EXACT;
+    }
+}
+
+/*!
+  \return whether \a s matches the pattern, like
+  fnmatch( pattern, s, 0 ) == 0
+*/
+bool GlobPattern::match( const string& s ) const
+{
+    switch ( m_kind ) {
+    case MATCH_ALL:
+        return true;
+    case EXACT:
+        return s == m_literal;
+    case PREFIX:
+        return s.compare( 0, m_literal.length(), m_literal ) == 0;
+    case SUFFIX:
+        return s.length() >= m_literal.length() &&
+            s.compare( s.length() - m_literal.length(),
+                       m_literal.length(), m_literal ) == 0;
+    case SUBSTRING:
+        return s.find( m_literal ) != string::npos;
+    default:
+        break;
+    }
+
+    return s.compare( 0, m_literal.length(), m_literal ) == 0 &&
+        fnmatch( m_pattern.c_str(), s.c_str(), 0 ) == 0;
+}
 
 }; // Namespace
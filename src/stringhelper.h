@@ -37,6 +37,10 @@ string getValueBefore( const string& s, char del );
 string toLowerCase( const string& s );
 string toUpperCase( const string& s );
 
+size_t findNoCase( const char* s, size_t length,
+                   const char* pattern, size_t patternLength );
+bool containsNoCase( const string& s, const string& pattern );
+
 string replaceAll( string& in,
                    const string& oldString,
                    const string& newString );
@@ -76,6 +80,27 @@ void split( const string& s, char del,
     }
 }
 
+/*!
+  \brief a pattern for fnmatch(), prepared to be matched against many
+  strings
+
+  Patterns which are plain strings, optionally with a leading and/or
+  trailing '*', are matched without calling fnmatch(); for all others,
+  the plain prefix is compared first.
+*/
+class GlobPattern
+{
+public:
+    GlobPattern( const string& pattern );
+    bool match( const string& s ) const;
+
+private:
+    enum Kind { MATCH_ALL, EXACT, PREFIX, SUFFIX, SUBSTRING, GENERIC };
+
+    string m_pattern;
+    string m_literal;   /*!< the plain part; the prefix for GENERIC */
+    Kind m_kind;
+};
 
 };
 #endif /* _STRINGHELPER_H_ */
@@ -0,0 +1,398 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        trigramindex.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+using namespace std;
+
+#include "cachefile.h"
+#include "trigramindex.h"
+
+namespace
+{
+    bool longerLiteral( const string& s1, const string& s2 )
+    {
+        return s1.length() > s2.length();
+    }
+
+    /*! intersect the sorted vectors \a records and \a other */
+    void intersect( vector<uint32_t>& records, const vector<uint32_t>& other )
+    {
+        vector<uint32_t> result;
+        set_intersection( records.begin(), records.end(),
+                          other.begin(), other.end(),
+                          back_inserter( result ) );
+        records.swap( result );
+    }
+}
+
+/*!
+  open the index stored in \a cache, for \a recordCount records; check
+  isValid() before using it
+*/
+TrigramIndex::TrigramIndex( const CacheFile* cache, size_t recordCount )
+    : m_rows( 0 ),
+      m_rowCount( 0 ),
+      m_postings( 0 ),
+      m_postingCount( 0 ),
+      m_recordCount( recordCount )
+{
+    m_rows = cache->table( CacheFile::TRIGRAMS,
+                           CacheFile::TRIGRAM_ROW, m_rowCount );
+    m_postings = cache->table( CacheFile::TRIGRAM_POSTINGS, 1,
+                               m_postingCount );
+}
+
+/*! \return whether the cache file contains an index */
+bool TrigramIndex::isValid() const
+{
+    return m_rows && m_postings;
+}
+
+/*!
+  find the records which may match \a pattern, either as substring or
+  as case insensitive regular expression
+  \param records is set to the sorted indices of the candidates
+  \return false if the index can't be used for \a pattern; all records
+          have to be checked then
+*/
+bool TrigramIndex::candidates( const string& pattern, bool isRegex,
+                               vector<uint32_t>& records ) const
+{
+    vector<string> literals;
+    if ( isRegex ) {
+        if ( !regexLiterals( pattern, literals ) ) {
+            return false;
+        }
+    } else if ( !pattern.empty() ) {
+        literals.push_back( pattern );
+    }
+
+    return candidates( literals, records );
+}
+
+/*!
+  find the records containing all of \a literals, ignoring case
+  \param records is set to the sorted indices of the candidates
+  \return false if there's no index or no literals
+*/
+bool TrigramIndex::candidates( vector<string> literals,
+                               vector<uint32_t>& records ) const
+{
+    if ( !isValid() || literals.empty() ) {
+        return false;
+    }
+
+    // one or two characters only narrow it down if there's nothing else
+    stable_sort( literals.begin(), literals.end(), longerLiteral );
+    records.clear();
+    for ( size_t i = 0; i < literals.size(); ++i ) {
+        if ( i > 0 && literals[i].length() < 3 &&
+             literals[0].length() >= 3 ) {
+            break;
+        }
+
+        vector<uint32_t> found;
+        lookup( literals[i], found );
+        if ( i == 0 ) {
+            records.swap( found );
+        } else {
+            intersect( records, found );
+        }
+        if ( records.empty() ) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+/*!
+  find the records containing \a literal
+*/
+void TrigramIndex::lookup( const string& literal,
+                           vector<uint32_t>& records ) const
+{
+    string s;
+    for ( size_t i = 0; i < literal.length(); ++i ) {
+        s += fold( literal[i] );
+    }
+
+    if ( s.length() < 3 ) {
+        uint32_t first = (unsigned char)s[0] << 16;
+        uint32_t last = first | 0xffff;
+        if ( s.length() == 2 ) {
+            first |= (unsigned char)s[1] << 8;
+            last = first | 0xff;
+        }
+        appendPostings( lowerBound( first ), lowerBound( last + 1 ),
+                        records );
+        sort( records.begin(), records.end() );
+        records.erase( unique( records.begin(), records.end() ),
+                       records.end() );
+        return;
+    }
+
+    for ( size_t i = 0; i + 2 < s.length(); ++i ) {
+        uint32_t key = (unsigned char)s[i] << 16 |
+            (unsigned char)s[i+1] << 8 | (unsigned char)s[i+2];
+        uint32_t row = lowerBound( key );
+        if ( row == m_rowCount ||
+             m_rows[row * CacheFile::TRIGRAM_ROW] != key ) {
+            records.clear();
+            return;
+        }
+
+        vector<uint32_t> found;
+        appendPostings( row, row + 1, found );
+        if ( i == 0 ) {
+            records.swap( found );
+        } else {
+            intersect( records, found );
+        }
+        if ( records.empty() ) {
+            return;
+        }
+    }
+}
+
+/*!
+  append the records listed for the rows \a first to \a last (exclusive)
+*/
+void TrigramIndex::appendPostings( uint32_t first, uint32_t last,
+                                   vector<uint32_t>& records ) const
+{
+    for ( uint32_t row = first; row < last; ++row ) {
+        const uint32_t* entry = m_rows + row * CacheFile::TRIGRAM_ROW;
+        uint32_t offset = entry[1];
+        uint32_t count = entry[2];
+        if ( offset > m_postingCount || count > m_postingCount - offset ) {
+            continue;
+        }
+        for ( uint32_t i = offset; i < offset + count; ++i ) {
+            if ( m_postings[i] < m_recordCount ) {
+                records.push_back( m_postings[i] );
+            }
+        }
+    }
+}
+
+/*!
+  \return the first row whose trigram is not less than \a key
+*/
+uint32_t TrigramIndex::lowerBound( uint32_t key ) const
+{
+    uint32_t low = 0;
+    uint32_t high = m_rowCount;
+    while ( low < high ) {
+        uint32_t mid = low + ( high - low ) / 2;
+        if ( m_rows[mid * CacheFile::TRIGRAM_ROW] < key ) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*!
+  collect strings every match of the regular expression \a pattern has
+  to contain. Stays on the safe side: only plain characters are taken,
+  and characters made optional by a quantifier are dropped
+  \return false if \a pattern uses alternatives or groups, which aren't
+          analyzed
+*/
+bool TrigramIndex::regexLiterals( const string& pattern,
+                                  vector<string>& literals )
+{
+    string current;
+    for ( string::size_type i = 0; i < pattern.length(); ++i ) {
+        char c = pattern[i];
+        bool flush = true;
+        switch ( c ) {
+        case '|':
+        case '(':
+        case ')':
+            return false;
+        case '*':
+        case '?':
+        case '{':
+            if ( !current.empty() ) {
+                current.erase( current.length() - 1 );
+            }
+            if ( c == '{' ) {
+                i = pattern.find( '}', i );
+                if ( i == string::npos ) {
+                    return false;
+                }
+            }
+            break;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+            break;
+        case '[': {
+            string::size_type j = i + 1;
+            if ( j < pattern.length() && pattern[j] == '^' ) {
+                ++j;
+            }
+            if ( j < pattern.length() && pattern[j] == ']' ) {
+                ++j;
+            }
+            while ( j < pattern.length() && pattern[j] != ']' ) {
+                if ( pattern[j] == '[' && j + 1 < pattern.length() &&
+                     strchr( ":.=", pattern[j+1] ) ) {
+                    string close = pattern.substr( j + 1, 1 ) + "]";
+                    j = pattern.find( close, j + 2 );
+                    if ( j == string::npos ) {
+                        return false;
+                    }
+                    ++j;
+                }
+                ++j;
+            }
+            if ( j >= pattern.length() ) {
+                return false;
+            }
+            i = j;
+            break;
+        }
+        case '\\':
+            if ( i + 1 < pattern.length() ) {
+                char next = pattern[++i];
+                // letters and digits are GNU operators like \w or \b
+                if ( !isalnum( (unsigned char)next ) &&
+                     !strchr( "<>`'", next ) ) {
+                    current += next;
+                    flush = false;
+                }
+            }
+            break;
+        default:
+            current += c;
+            flush = false;
+            break;
+        }
+
+        if ( flush && !current.empty() ) {
+            literals.push_back( current );
+            current.clear();
+        }
+    }
+
+    if ( !current.empty() ) {
+        literals.push_back( current );
+    }
+    return true;
+}
+
+/*!
+  collect the plain strings every string matching the fnmatch() pattern
+  \a pattern has to contain
+*/
+void TrigramIndex::globLiterals( const string& pattern,
+                                 vector<string>& literals )
+{
+    string current;
+    for ( string::size_type i = 0; i < pattern.length(); ++i ) {
+        char c = pattern[i];
+        bool flush = true;
+        if ( c == '[' ) {
+            // an unterminated bracket is a plain '[', which is dropped
+            string::size_type j = i + 1;
+            if ( j < pattern.length() &&
+                 ( pattern[j] == '!' || pattern[j] == '^' ) ) {
+                ++j;
+            }
+            if ( j < pattern.length() && pattern[j] == ']' ) {
+                ++j;
+            }
+            j = pattern.find( ']', j );
+            if ( j != string::npos ) {
+                i = j;
+            }
+        } else if ( c == '\\' && i + 1 < pattern.length() ) {
+            current += pattern[++i];
+            flush = false;
+        } else if ( c != '*' && c != '?' ) {
+            current += c;
+            flush = false;
+        }
+
+        if ( flush && !current.empty() ) {
+            literals.push_back( current );
+            current.clear();
+        }
+    }
+
+    if ( !current.empty() ) {
+        literals.push_back( current );
+    }
+}
+
+/*!
+  store the index of \a texts, the text of record i being texts[i], in
+  the cache written by \a writer
+*/
+void TrigramIndex::write( CacheWriter& writer, const vector<string>& texts )
+{
+    // trigram in the upper, record in the lower half
+    vector<uint64_t> entries;
+    for ( size_t i = 0; i < texts.size(); ++i ) {
+        const string& text = texts[i];
+        uint32_t key = 0;
+        for ( size_t j = 0; j < text.length() + 2; ++j ) {
+            unsigned char c = j < text.length() ? fold( text[j] ) : 0;
+            key = ( key << 8 | c ) & 0xffffff;
+            if ( j >= 2 ) {
+                entries.push_back( (uint64_t)key << 32 | i );
+            }
+        }
+    }
+    sort( entries.begin(), entries.end() );
+    entries.erase( unique( entries.begin(), entries.end() ), entries.end() );
+
+    vector<uint32_t> rows;
+    vector<uint32_t> postings;
+    postings.reserve( entries.size() );
+    for ( size_t i = 0; i < entries.size(); ++i ) {
+        uint32_t key = entries[i] >> 32;
+        if ( rows.empty() ||
+             rows[rows.size() - CacheFile::TRIGRAM_ROW] != key ) {
+            rows.push_back( key );
+            rows.push_back( postings.size() );
+            rows.push_back( 0 );
+        }
+        ++rows.back();
+        postings.push_back( (uint32_t)entries[i] );
+    }
+
+    writer.addTable( CacheFile::TRIGRAMS, CacheFile::TRIGRAM_ROW, rows );
+    writer.addTable( CacheFile::TRIGRAM_POSTINGS, 1, postings );
+}
+
+/*!
+  \return \a c as stored in the index: ASCII letters in lowercase, all
+  other bytes above 127 as 128
+*/
+unsigned char TrigramIndex::fold( unsigned char c )
+{
+    if ( c >= 'A' && c <= 'Z' ) {
+        return c - 'A' + 'a';
+    }
+    if ( c >= 0x80 ) {
+        return 0x80;
+    }
+    return c;
+}
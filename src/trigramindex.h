@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        trigramindex.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _TRIGRAMINDEX_H_
+#define _TRIGRAMINDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CacheFile;
+class CacheWriter;
+
+/*!
+  \class TrigramIndex
+  \brief inverted index of the trigrams in the texts of the records of
+  a cache file
+
+  For the packages of the repository cache, the text is the name and
+  description; for FootprintIndex, it's the path of a file. Texts are
+  lowercased, with all non-ASCII bytes folded into one value. Every
+  trigram, plus two trailing null bytes so patterns shorter than three
+  characters can be looked up by prefix, maps to the sorted list of
+  records whose text contains it.
+
+  The index only excludes records which can't match; candidates still
+  have to be checked against the pattern.
+
+  Stored in the TRIGRAMS and TRIGRAM_POSTINGS sections of the cache
+  file; caches without them are searched without an index.
+*/
+class TrigramIndex
+{
+public:
+    TrigramIndex( const CacheFile* cache, size_t recordCount );
+
+    bool isValid() const;
+    bool candidates( const std::string& pattern, bool isRegex,
+                     std::vector<uint32_t>& records ) const;
+    bool candidates( std::vector<std::string> literals,
+                     std::vector<uint32_t>& records ) const;
+
+    static bool regexLiterals( const std::string& pattern,
+                               std::vector<std::string>& literals );
+    static void globLiterals( const std::string& pattern,
+                              std::vector<std::string>& literals );
+
+    static void write( CacheWriter& writer,
+                       const std::vector<std::string>& texts );
+
+private:
+    void lookup( const std::string& literal,
+                 std::vector<uint32_t>& records ) const;
+    void appendPostings( uint32_t first, uint32_t last,
+                         std::vector<uint32_t>& records ) const;
+    uint32_t lowerBound( uint32_t key ) const;
+
+    static unsigned char fold( unsigned char c );
+
+    const uint32_t* m_rows;
+    uint32_t m_rowCount;
+    const uint32_t* m_postings;
+    uint32_t m_postingCount;
+    size_t m_recordCount;
+};
+
+#endif /* _TRIGRAMINDEX_H_ */
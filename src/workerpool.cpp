@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        workerpool.cpp
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+using namespace std;
+
+#include <unistd.h>
+#include <pthread.h>
+
+#include "workerpool.h"
+
+namespace
+{
+    /*! state shared between the threads of one WorkerPool::run() call */
+    struct PoolState
+    {
+        size_t next;
+        size_t count;
+        WorkerPool::Job job;
+        void* data;
+    };
+
+    // upper limit, mostly to protect against bogus sysconf() results
+    const unsigned int MAX_THREADS = 64;
+}
+
+/*!
+  \return the number of threads used when run() isn't told otherwise
+*/
+unsigned int WorkerPool::defaultThreadCount()
+{
+    long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    if ( cpus < 1 ) {
+        return 1;
+    }
+    if ( cpus > (long)MAX_THREADS ) {
+        return MAX_THREADS;
+    }
+    return cpus;
+}
+
+/*!
+  run \a job for every index in [0, \a count)
+  \param count number of jobs
+  \param job the function to be called for each job
+  \param data passed to each call of \a job
+  \param threads number of threads to use; 0 means defaultThreadCount()
+*/
+void WorkerPool::run( size_t count, Job job, void* data,
+                      unsigned int threads )
+{
+    if ( threads == 0 ) {
+        threads = defaultThreadCount();
+    }
+    if ( threads > count ) {
+        threads = count;
+    }
+
+    PoolState state;
+    state.next = 0;
+    state.count = count;
+    state.job = job;
+    state.data = data;
+
+    vector<pthread_t> workers;
+    for ( unsigned int i = 1; i < threads; ++i ) {
+        pthread_t thread;
+        if ( pthread_create( &thread, 0, worker, &state ) != 0 ) {
+            // run with what we've got; the calling thread works as well
+            break;
+        }
+        workers.push_back( thread );
+    }
+
+    worker( &state );
+
+    vector<pthread_t>::iterator it = workers.begin();
+    for ( ; it != workers.end(); ++it ) {
+        pthread_join( *it, 0 );
+    }
+}
+
+void* WorkerPool::worker( void* arg )
+{
+    PoolState* state = static_cast<PoolState*>( arg );
+
+    size_t index;
+    while ( ( index = __sync_fetch_and_add( &state->next, 1 ) )
+            < state->count ) {
+        state->job( index, state->data );
+    }
+
+    return 0;
+}
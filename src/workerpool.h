@@ -0,0 +1,39 @@
+////////////////////////////////////////////////////////////////////////
+// FILE:        workerpool.h
+// AUTHOR:      agent, agent@local
+// COPYRIGHT:   (c) 2026 by agent
+// ---------------------------------------------------------------------
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef _WORKERPOOL_H_
+#define _WORKERPOOL_H_
+
+#include <cstddef>
+
+/*!
+  \class WorkerPool
+  \brief run a number of independent jobs on a pool of threads
+
+  Jobs are identified by their index; each index in [0, count) is passed
+  to the job function exactly once. The calling thread takes part in the
+  work and run() returns after all jobs are done.
+*/
+class WorkerPool
+{
+public:
+    typedef void (*Job)( size_t index, void* data );
+
+    static void run( size_t count, Job job, void* data,
+                     unsigned int threads = 0 );
+
+    static unsigned int defaultThreadCount();
+
+private:
+    static void* worker( void* arg );
+};
+
+#endif /* _WORKERPOOL_H_ */